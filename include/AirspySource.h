@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <mutex>
 #include "libairspy/airspy.h"
 
 #include "DeviceSource.h"
@@ -95,7 +96,15 @@ private:
 
     void callback(const short* buf, int len);
     static int rx_callback(airspy_transfer_t* transfer);
-    static void run(airspy_device* dev, std::atomic_bool *stop_flag);
+    static void run(AirspySource *source);
+
+    /**
+     * The library is initialized by the first user (device or device list) and
+     * left by the last one so that devices stay usable while others are opened
+     * or closed.
+     */
+    static airspy_error library_init();
+    static airspy_error library_exit();
 
     struct airspy_device* m_dev;
     uint32_t m_sampleRate;
@@ -109,7 +118,9 @@ private:
     bool m_mixAGC;
     bool m_running;
     std::thread *m_thread;
-    static AirspySource *m_this;
+    bool m_libraryInit; //!< this instance counts as a library user
+    static std::mutex m_libraryMutex;
+    static int m_libraryUsers;
     static const std::vector<int> m_lgains;
     static const std::vector<int> m_mgains;
     static const std::vector<int> m_vgains;
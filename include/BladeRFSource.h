@@ -93,9 +93,18 @@ private:
      * This function must be called regularly to maintain streaming.
      * Return true for success, false if an error occurred.
      */
-    static bool get_samples(IQSampleVector *samples);
+    static bool get_samples(BladeRFSource *source, IQSampleVector *samples);
 
-    static void run();
+    /** Validate the synchronous interface parameters applied at start */
+    bool configure_sync(parsekv::pairs_type& m);
+
+    static void run(BladeRFSource *source);
+
+    static const int default_block_size = 1<<14;
+    static const unsigned int default_nb_buffers = 64;
+    static const unsigned int default_buffer_size = 8192;
+    static const unsigned int default_nb_transfers = 32;
+    static const unsigned int default_stream_timeout = 10000;
 
     struct bladerf *m_dev;
     uint32_t m_sampleRate;
@@ -107,9 +116,13 @@ private:
     int m_lnaGain;
     int m_vga1Gain;
     int m_vga2Gain;
+    int m_blockSize;              //!< samples per block read from the device
+    unsigned int m_nbBuffers;     //!< libbladeRF stream buffers
+    unsigned int m_bufferSize;    //!< samples per stream buffer (multiple of 1024)
+    unsigned int m_nbTransfers;   //!< USB transfers in flight
+    unsigned int m_streamTimeout; //!< stream timeout in ms
+    bool m_syncChanged;           //!< stream parameters must be applied at start
     std::thread *m_thread;
-    static const int m_blockSize = 1<<14;
-    static BladeRFSource *m_this;
     static const std::vector<int> m_lnaGains;
     static const std::vector<int> m_vga1Gains;
     static const std::vector<int> m_vga2Gains;
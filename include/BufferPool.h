@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_BUFFERPOOL_H_
+#define INCLUDE_BUFFERPOOL_H_
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Free list of sample blocks so that the storage of processed blocks is reused
+ * instead of being freed and allocated again for every device transfer.
+ *
+ * The free list is reserved at construction so taking and giving back blocks
+ * never allocates. The lock is only held to move a vector in or out of the
+ * list. Any thread may get or put blocks. When the list is full the block
+ * given back is simply freed.
+ */
+template <class Element>
+class BufferPool
+{
+public:
+    /** Construct pool keeping at most max_blocks free blocks */
+    explicit BufferPool(std::size_t max_blocks = 32) :
+        m_max_blocks(max_blocks),
+        m_allocated(0),
+        m_reused(0)
+    {
+        m_free.reserve(max_blocks);
+    }
+
+    /**
+     * Get a block of n elements. A free block of the same size is preferred
+     * as resizing it costs nothing, then any free block large enough. Elements
+     * content is undefined.
+     */
+    std::vector<Element> get(std::size_t n)
+    {
+        std::vector<Element> block;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::size_t nb_free = m_free.size();
+        std::size_t best = nb_free;
+
+        for (std::size_t i = nb_free; i > 0; i--)
+        {
+            if (m_free[i-1].size() == n)
+            {
+                best = i-1;
+                break;
+            }
+
+            if ((best == nb_free) && (m_free[i-1].capacity() >= n)) {
+                best = i-1;
+            }
+        }
+
+        if (best < nb_free)
+        {
+            block.swap(m_free[best]);
+            m_free[best].swap(m_free.back());
+            m_free.pop_back();
+            lock.unlock();
+            m_reused++;
+        }
+        else
+        {
+            lock.unlock();
+            m_allocated++;
+        }
+
+        block.resize(n);
+        return block;
+    }
+
+    /** Give back the storage of a block that is not used anymore */
+    void put(std::vector<Element>&& block)
+    {
+        if (block.capacity() == 0) {
+            return;
+        }
+
+        std::vector<Element> dropped; // freed outside the lock
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_free.size() < m_max_blocks)
+        {
+            m_free.push_back(std::vector<Element>());
+            m_free.back().swap(block);
+        }
+        else
+        {
+            dropped.swap(block);
+        }
+    }
+
+    /** Number of blocks that could not be taken from the free list */
+    std::size_t allocated() const { return m_allocated.load(); }
+    /** Number of blocks taken from the free list */
+    std::size_t reused() const { return m_reused.load(); }
+
+private:
+    std::size_t                       m_max_blocks;
+    std::vector<std::vector<Element>> m_free;
+    std::mutex                        m_mutex;
+    std::atomic<std::size_t>          m_allocated;
+    std::atomic<std::size_t>          m_reused;
+};
+
+#endif /* INCLUDE_BUFFERPOOL_H_ */
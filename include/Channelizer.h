@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_CHANNELIZER_H_
+#define INCLUDE_CHANNELIZER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "SDRDaemon.h"
+
+class WorkerPool;
+
+#define CHANNELIZER_MAX_CHANNELS 256 // largest number of channels (power of two)
+#define CHANNELIZER_BRANCH_TAPS  16  // taps of each polyphase branch of the prototype filter
+#define CHANNELIZER_MIN_FRAMES   64  // fewest output samples of each channel computed by one thread
+
+/**
+ * Polyphase filter bank splitting the input band in N channels of equal width with
+ * one FFT per output sample of all channels.
+ *
+ * Channel k is centered on k/N of the input rate and is the output of the prototype
+ * low pass filter after shifting the channel to 0 Hz. The prototype is a Blackman
+ * windowed sinc of N * CHANNELIZER_BRANCH_TAPS taps cut at half the channel spacing
+ * so that adjacent channels cross at -6 dB. Channels are decimated by N/2 only: the
+ * output rate is twice the channel spacing so that the transition band does not alias
+ * into the channel.
+ *
+ * Each output sample needs the N branch dot products of CHANNELIZER_BRANCH_TAPS taps
+ * done on separate I and Q float arrays which the compiler vectorizes, then an N
+ * points FFT. The phase of the shift to 0 Hz is applied by rotating the FFT input so
+ * that the output of a channel is the same as mixing the input with a continuous
+ * oscillator before filtering. Output samples of a block do not depend on each other
+ * so they are shared between threads of a worker pool.
+ */
+class Channelizer
+{
+public:
+    Channelizer();
+
+    /**
+     * Set number of channels, a power of two from 2 to CHANNELIZER_MAX_CHANNELS, and
+     * design the filter. Return false if not supported. The filter history is cleared.
+     */
+    bool setNbChannels(unsigned int nbChannels);
+
+    unsigned int getNbChannels() const { return m_nbChannels; }
+
+    /** Return decimation of the channels output relative to the input */
+    unsigned int getDecimation() const { return m_nbChannels / 2; }
+
+    /**
+     * Return center frequency of output channel index relative to the center of the
+     * input band as a fraction of the input rate. Channels are output in increasing
+     * frequency order: index N/2 is centered on the input band.
+     */
+    double getChannelFrequency(unsigned int index) const;
+
+    /** Set the pool of threads sharing the computation of blocks. Blocks are computed by the calling thread without. */
+    void setWorkerPool(WorkerPool *pool) { m_pool = pool; }
+
+    /** Set number of threads sharing the computation of blocks including the calling one */
+    void setNbThreads(unsigned int nbThreads);
+
+    /**
+     * Split in to the N channels of out. out is resized to N vectors resized to the
+     * number of samples produced.
+     */
+    void process(const IQSampleVector& in, std::vector<IQSampleVector>& out);
+
+private:
+    /** Work arrays of one thread */
+    struct Work
+    {
+        std::vector<float> m_branchRe; //!< dot products of the branches
+        std::vector<float> m_branchIm;
+        std::vector<float> m_fftRe;    //!< FFT input in bit reversed order then output
+        std::vector<float> m_fftIm;
+    };
+
+    unsigned int m_nbChannels;   //!< N
+    unsigned int m_nbTaps;       //!< prototype length N * CHANNELIZER_BRANCH_TAPS
+    unsigned int m_phase;        //!< input sample count modulo N at the last sample of the next output
+    std::size_t  m_index;        //!< index of the last input sample of the next output in the input arrays
+    std::vector<float> m_taps;   //!< prototype in reverse order so that taps and input samples are in the same order
+    std::vector<float> m_re;     //!< history of nbTaps - 1 samples followed by the input block
+    std::vector<float> m_im;
+    std::vector<float> m_twiddleRe;       //!< exp(j*pi*k/n) for k < n of each FFT stage of half size n
+    std::vector<float> m_twiddleIm;
+    std::vector<unsigned int> m_reversed; //!< bit reversed index of each FFT input
+    std::vector<Work>  m_work;
+    WorkerPool        *m_pool;
+    unsigned int       m_nbThreads;
+
+    void processFrames(std::size_t first, std::size_t count, Work& work, std::vector<IQSampleVector>& out);
+    void fft(float *re, float *im) const;
+};
+
+#endif /* INCLUDE_CHANNELIZER_H_ */
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_CPUFEATURES_H_
+#define INCLUDE_CPUFEATURES_H_
+
+#include <string>
+
+#if defined(__arm__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/**
+ * SIMD instruction sets of the CPU the program runs on. This is checked at run
+ * time so that a binary built on one machine selects the best kernels available
+ * on the machine it is run on.
+ *
+ * The kernels can be restricted to a lower level with setLevel (e.g. to compare
+ * their performance). This has to be done before any kernel is used as kernels
+ * are selected on first use.
+ */
+class CpuFeatures
+{
+public:
+    /** Instruction set levels from the lowest. x86 levels include the lower ones. */
+    enum Level
+    {
+        LevelGeneric,
+        LevelSSE2,
+        LevelSSE41,
+        LevelAVX2,
+        LevelAVX512,
+        LevelNEON,
+        LevelAuto
+    };
+
+    static bool hasSSE2()   { return allowed(LevelSSE2) && supports(LevelSSE2); }
+    static bool hasSSE41()  { return allowed(LevelSSE41) && supports(LevelSSE41); }
+    static bool hasAVX2()   { return allowed(LevelAVX2) && supports(LevelAVX2); }
+    static bool hasAVX512F() { return allowed(LevelAVX512) && supports(LevelAVX512); }
+    static bool hasNEON()   { return allowed(LevelNEON) && supports(LevelNEON); }
+
+    /** AVX-512 with the 8 and 16 bit integer instructions */
+    static bool hasAVX512BW()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return hasAVX512F() && __builtin_cpu_supports("avx512bw");
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Restrict kernels to the given level: generic, sse2, sse4.1, avx2 or avx512 on x86,
+     * generic or neon on ARM, auto for the best available (default). Return false if the
+     * level is unknown or not supported by this CPU.
+     */
+    static bool setLevel(const std::string& name)
+    {
+        static const char *names[] = {"generic", "sse2", "sse4.1", "avx2", "avx512", "neon", "auto"};
+
+        for (int level = LevelGeneric; level <= LevelAuto; level++)
+        {
+            if (name == names[level])
+            {
+                if ((level != LevelAuto) && !supports((Level) level)) {
+                    return false;
+                }
+
+                maxLevel() = (Level) level;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static Level& maxLevel()
+    {
+        static Level level = LevelAuto;
+        return level;
+    }
+
+    static bool allowed(Level level)
+    {
+        return (maxLevel() == LevelAuto) || (maxLevel() >= level);
+    }
+
+    static bool supports(Level level)
+    {
+        switch (level)
+        {
+        case LevelGeneric:
+            return true;
+#if defined(__x86_64__)
+        case LevelSSE2:
+            return true;
+#elif defined(__i386__)
+        case LevelSSE2:
+            return __builtin_cpu_supports("sse2");
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+        case LevelSSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case LevelAVX2:
+            return __builtin_cpu_supports("avx2");
+        case LevelAVX512:
+            return __builtin_cpu_supports("avx512f");
+#elif defined(__aarch64__)
+        case LevelNEON:
+            return true;
+#elif defined(__arm__)
+        case LevelNEON:
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+        default:
+            return false;
+        }
+    }
+};
+
+#endif /* INCLUDE_CPUFEATURES_H_ */
@@ -20,33 +20,202 @@
 #define _INCLUDE_DATABUFFER_H_
 
 #include <queue>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <cstdint>
 
+#include "SPSCRing.h"
+#include "BufferPool.h"
+#include "SampleStamp.h"
 
-/** Buffer to move sample data between threads. */
+
+/**
+ * Buffer to move sample data between threads.
+ *
+ * By default blocks are kept in an unbounded queue protected by a mutex.
+ * When constructed with a non zero ring size the buffer instead uses a
+ * preallocated lock-free single producer single consumer ring of that many
+ * blocks. In that mode push never blocks nor allocates so it can be called
+ * from a USB callback: when the ring is full the block is dropped and counted.
+ * The pull side spins for a short while then sleeps until the producer
+ * signals new data.
+ *
+ * A BufferPool can be attached so that producers take their blocks with
+ * get_block and consumers give them back with recycle once processed. The
+ * sample blocks storage is then reused and the flow runs without allocation.
+ * In ring mode the blocks given back go first to a second lock-free ring read
+ * by get_block so that the producer takes no lock either: the pool is only
+ * used when this free ring is empty or full.
+ *
+ * A capacity in samples can be set with set_capacity. Pushing beyond it
+ * applies the overflow policy: wait for the consumer, drop the incoming
+ * block or drop the oldest queued blocks. Dropped samples and blocks are
+ * counted so that the latency stays bounded and losses are visible.
+ *
+ * Each block may carry the SampleStamp of its first sample. It is moved along
+ * with the block and blocks pushed without one get an invalid stamp.
+ */
 template <class Element>
 class DataBuffer
 {
 public:
-    /** Constructor. */
-    DataBuffer()
+    /** What to do when a push would exceed the capacity */
+    enum OverflowPolicy
+    {
+        OverflowBlock,      //!< producer waits until there is room
+        OverflowDropNewest, //!< incoming block is dropped
+        OverflowDropOldest  //!< oldest queued blocks are dropped (queue mode only)
+    };
+
+    /** Number of polls of the ring before the consumer goes to sleep */
+    static const int ring_spin_count = 64;
+
+    /**
+     * Constructor.
+     *
+     * ring_size :: 0 for the mutex protected queue else number of blocks
+     *              in the lock-free ring
+     */
+    DataBuffer(std::size_t ring_size = 0)
         : m_qlen(0)
         , m_end_marked(false)
+        , m_ring(ring_size > 0 ? new SPSCRing<Slot>(ring_size) : 0)
+        , m_free_ring(ring_size > 0 ? new SPSCRing<std::vector<Element>>(ring_size + 2) : 0)
+        , m_consumer_waiting(false)
+        , m_producer_waiting(false)
+        , m_capacity(0)
+        , m_policy(OverflowDropOldest)
+        , m_dropped_samples(0)
+        , m_dropped_vectors(0)
+        , m_pushed_samples(0)
+        , m_pool(0)
     { }
 
+    /** Attach a pool of blocks. It may be shared by several buffers. */
+    void set_pool(BufferPool<Element> *pool) { m_pool = pool; }
+
+    /**
+     * Set the high watermark in number of samples (0 for unbounded) and the
+     * policy applied when it is reached. In ring mode the oldest blocks cannot
+     * be dropped from the producer side so OverflowDropOldest drops the
+     * incoming block instead. Set it before the producer starts.
+     */
+    void set_capacity(std::size_t max_samples, OverflowPolicy policy)
+    {
+        m_capacity = max_samples;
+        m_policy = policy;
+    }
+
+    /** Return the capacity in samples (0 for unbounded) */
+    std::size_t capacity() const { return m_capacity; }
+
+    /** Get a block of n elements for pushing. Content is undefined. Producer side. */
+    std::vector<Element> get_block(std::size_t n)
+    {
+        std::vector<Element> block;
+
+        if (m_free_ring && ((m_spare.capacity() > 0) || m_free_ring->pull(m_spare)))
+        {
+            block.swap(m_spare);
+            block.resize(n);
+            return block;
+        }
+
+        if (m_pool) {
+            return m_pool->get(n);
+        }
+
+        block.resize(n);
+        return block;
+    }
+
+    /** Give back a block taken with get_block that was not pushed. Producer side. */
+    void unget_block(std::vector<Element>&& block)
+    {
+        if (!m_free_ring)
+        {
+            recycle(std::move(block));
+            return;
+        }
+
+        if (block.capacity() > m_spare.capacity()) {
+            m_spare.swap(block);
+        }
+
+        if (m_pool) {
+            m_pool->put(std::move(block));
+        }
+    }
+
+    /** Give back a pulled block when its samples have been used. Consumer side. */
+    void recycle(std::vector<Element>&& block)
+    {
+        // the ring hands back the empty vector left in the slot by get_block
+        if (m_free_ring && (block.capacity() > 0) && m_free_ring->push(block)) {
+            return;
+        }
+
+        if (m_pool) {
+            m_pool->put(std::move(block));
+        }
+    }
+
+    /** Return true if the lock-free ring is used */
+    bool is_ring() const { return m_ring.get() != 0; }
+
     /** Add samples to the queue. */
     void push(std::vector<Element>&& samples)
     {
-        if (!samples.empty()) {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_qlen += samples.size();
-            m_queue.push(move(samples));
-            lock.unlock();
-            m_cond.notify_all();
+        push(std::move(samples), SampleStamp());
+    }
+
+    /** Add samples to the queue with the stamp of the first sample. */
+    void push(std::vector<Element>&& samples, const SampleStamp& stamp)
+    {
+        if (!samples.empty())
+        {
+            if (m_ring) {
+                ring_push(samples, stamp);
+            } else {
+                queue_push(samples, stamp);
+            }
         }
     }
 
+    /**
+     * Wait until a block of n samples can be pushed without exceeding max_samples
+     * queued samples (a block always fits in an empty buffer) and, in ring mode,
+     * there is a free slot. Producers that can wait for the consumer call it
+     * before pushing so that no block is dropped whatever the overflow policy.
+     * Return at once when the end of stream is marked.
+     */
+    void wait_room(std::size_t n, std::size_t max_samples)
+    {
+        auto ready = [this, n, max_samples]() {
+            std::size_t qlen = m_qlen.load();
+            bool fits = (qlen == 0) || (qlen + n <= max_samples);
+            return (fits && (!m_ring || (m_ring->size() < m_ring->capacity()))) || m_end_marked;
+        };
+
+        if (m_ring)
+        {
+            wait_on(m_producer_waiting, ready);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_producer_waiting.store(true);
+
+        while (!ready())
+            m_cond.wait(lock);
+
+        m_producer_waiting.store(false);
+    }
+
     /** Mark the end of the data stream. */
     void push_end()
     {
@@ -59,6 +228,10 @@ public:
     /** Return number of samples in queue. */
     std::size_t queued_samples()
     {
+        if (m_ring) {
+            return m_qlen.load();
+        }
+
         std::unique_lock<std::mutex> lock(m_mutex);
         return m_qlen;
     }
@@ -66,10 +239,23 @@ public:
     /** Return number of vectors in queue. */
     std::size_t queued_vectors()
     {
+        if (m_ring) {
+            return m_ring->size();
+        }
+
         std::unique_lock<std::mutex> lock(m_mutex);
         return m_queue.size();
     }
 
+    /** Return number of samples dropped on overflow since start. */
+    std::size_t dropped_samples() const { return m_dropped_samples.load(); }
+
+    /** Return number of vectors dropped on overflow since start. */
+    std::size_t dropped_vectors() const { return m_dropped_vectors.load(); }
+
+    /** Return number of samples queued since start (throughput of the producer). */
+    std::uint64_t pushed_samples() const { return m_pushed_samples.load(); }
+
     /**
      * If the queue is non-empty, remove a block from the queue and
      * return the samples. If the end marker has been reached, return
@@ -79,14 +265,7 @@ public:
     std::vector<Element> pull()
     {
         std::vector<Element> ret;
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_queue.empty() && !m_end_marked)
-            m_cond.wait(lock);
-        if (!m_queue.empty()) {
-            m_qlen -= m_queue.front().size();
-            swap(ret, m_queue.front());
-            m_queue.pop();
-        }
+        pull(ret);
         return ret;
     }
 
@@ -95,19 +274,55 @@ public:
      */
     void pull(std::vector<Element>& ret)
     {
+        SampleStamp stamp;
+        pull(ret, stamp);
+    }
+
+    /**
+     * Pull a block with the stamp of its first sample. The stamp is invalid
+     * at end of stream.
+     */
+    void pull(std::vector<Element>& ret, SampleStamp& stamp)
+    {
+        stamp = SampleStamp();
+
+        if (m_ring)
+        {
+            ret.clear();
+
+            if (!ring_pull(ret, stamp))
+            {
+                wait_on(m_consumer_waiting, [this]() { return !m_ring->empty() || m_end_marked; });
+                ring_pull(ret, stamp);
+            }
+
+            return;
+        }
+
         std::unique_lock<std::mutex> lock(m_mutex);
         while (m_queue.empty() && !m_end_marked)
             m_cond.wait(lock);
         if (!m_queue.empty()) {
-            m_qlen -= m_queue.front().size();
-            swap(ret, m_queue.front());
+            m_qlen -= m_queue.front().m_samples.size();
+            swap(ret, m_queue.front().m_samples);
+            stamp = m_queue.front().m_stamp;
             m_queue.pop();
+
+            if (m_producer_waiting.load())
+            {
+                lock.unlock();
+                m_cond.notify_all();
+            }
         }
     }
 
     /** Return true if the end has been reached at the Pull side. */
     bool pull_end_reached()
     {
+        if (m_ring) {
+            return m_qlen.load() == 0 && m_end_marked;
+        }
+
         std::unique_lock<std::mutex> lock(m_mutex);
         return m_qlen == 0 && m_end_marked;
     }
@@ -115,6 +330,12 @@ public:
     /** Wait until the buffer contains minfill samples or an end marker. */
     void wait_buffer_fill(std::size_t minfill)
     {
+        if (m_ring)
+        {
+            wait_on(m_consumer_waiting, [this, minfill]() { return m_qlen.load() >= minfill || m_end_marked; });
+            return;
+        }
+
         std::unique_lock<std::mutex> lock(m_mutex);
         while (m_qlen < minfill && !m_end_marked)
             m_cond.wait(lock);
@@ -127,12 +348,171 @@ public:
     }
 
 private:
-    std::size_t              m_qlen;
-    bool                     m_end_marked;
-    std::queue<std::vector<Element>> m_queue;
+    /** Queue or ring element */
+    struct Slot
+    {
+        std::vector<Element> m_samples;
+        SampleStamp          m_stamp;
+    };
+
+    std::atomic<std::size_t> m_qlen;
+    std::atomic_bool         m_end_marked;
+    std::queue<Slot>         m_queue;
     std::mutex               m_mutex;
     std::condition_variable  m_cond;
+    std::unique_ptr<SPSCRing<Slot>> m_ring;
+    std::unique_ptr<SPSCRing<std::vector<Element>>> m_free_ring; //!< blocks given back by the consumer (ring mode)
+    std::vector<Element>     m_spare;            //!< block given back by the producer (ring mode)
+    std::atomic_bool         m_consumer_waiting; //!< consumer is (about to be) asleep on m_cond
+    std::atomic_bool         m_producer_waiting; //!< producer is (about to be) asleep on m_cond
+    std::size_t              m_capacity;
+    OverflowPolicy           m_policy;
+    std::atomic<std::size_t> m_dropped_samples;
+    std::atomic<std::size_t> m_dropped_vectors;
+    std::atomic<std::uint64_t> m_pushed_samples;
+    BufferPool<Element>     *m_pool;
+
+    /** True if n more samples fit. A block always fits in an empty buffer. */
+    bool has_room(std::size_t n) const
+    {
+        std::size_t qlen = m_qlen.load();
+        return (m_capacity == 0) || (qlen == 0) || (qlen + n <= m_capacity);
+    }
+
+    void drop(std::vector<Element>& samples)
+    {
+        m_dropped_samples.fetch_add(samples.size());
+        m_dropped_vectors.fetch_add(1);
+        unget_block(std::move(samples)); // only the producer drops blocks
+        samples.clear();
+    }
+
+    void queue_push(std::vector<Element>& samples, const SampleStamp& stamp)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (!has_room(samples.size()))
+        {
+            if (m_policy == OverflowBlock)
+            {
+                m_producer_waiting.store(true);
+
+                while (!has_room(samples.size()) && !m_end_marked)
+                    m_cond.wait(lock);
+
+                m_producer_waiting.store(false);
+            }
+            else if (m_policy == OverflowDropOldest)
+            {
+                while (!m_queue.empty() && !has_room(samples.size()))
+                {
+                    m_qlen -= m_queue.front().m_samples.size();
+                    drop(m_queue.front().m_samples);
+                    m_queue.pop();
+                }
+            }
+            else
+            {
+                lock.unlock();
+                drop(samples);
+                return;
+            }
+        }
+
+        m_qlen += samples.size();
+        m_pushed_samples += samples.size();
+        m_queue.push(Slot());
+        m_queue.back().m_samples.swap(samples);
+        m_queue.back().m_stamp = stamp;
+        lock.unlock();
+        m_cond.notify_all();
+    }
+
+    void ring_push(std::vector<Element>& samples, const SampleStamp& stamp)
+    {
+        std::size_t n = samples.size();
+        Slot slot;
+
+        if (!has_room(n) && (m_policy == OverflowBlock)) {
+            wait_on(m_producer_waiting, [this, n]() { return has_room(n) || m_end_marked; });
+        }
+
+        slot.m_samples.swap(samples);
+        slot.m_stamp = stamp;
+
+        if (has_room(n))
+        {
+            // Count the samples before the consumer can pull them so that m_qlen never wraps
+            m_qlen.fetch_add(n);
+
+            if (m_ring->push(slot))
+            {
+                unget_block(std::move(slot.m_samples)); // storage of a consumed block
+                m_pushed_samples.fetch_add(n);
+                wake(m_consumer_waiting);
+                return;
+            }
+
+            m_qlen.fetch_sub(n);
+        }
+
+        drop(slot.m_samples);
+    }
+
+    bool ring_pull(std::vector<Element>& ret, SampleStamp& stamp)
+    {
+        Slot slot;
+        slot.m_samples.swap(ret); // storage handed back to the producer
+
+        if (m_ring->pull(slot))
+        {
+            ret.swap(slot.m_samples);
+            stamp = slot.m_stamp;
+            m_qlen.fetch_sub(ret.size());
+            wake(m_producer_waiting);
+            return true;
+        }
+
+        ret.swap(slot.m_samples);
+        return false;
+    }
+
+    /** Only touch the mutex when the other side sleeps */
+    void wake(std::atomic_bool& waiting)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (waiting.load())
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            lock.unlock();
+            m_cond.notify_all();
+        }
+    }
+
+    /** Spin then sleep until the predicate holds */
+    template <class Predicate>
+    void wait_on(std::atomic_bool& waiting, Predicate ready)
+    {
+        for (int i = 0; i < ring_spin_count; i++)
+        {
+            if (ready()) {
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        waiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        while (!ready()) {
+            m_cond.wait(lock);
+        }
+
+        waiting.store(false);
+    }
 };
 
 #endif
-
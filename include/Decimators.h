@@ -19,55 +19,53 @@
 #ifndef INCLUDE_DECIMATORS_H_
 #define INCLUDE_DECIMATORS_H_
 
+#include <cstddef>
 #include "SDRDaemon.h"
-
-#if defined(USE_SSE4_1)
-#include "IntHalfbandFilterEO1.h"
-#else
-#include "IntHalfbandFilterDB.h"
-#endif
+#include "HBFilterCascade.h"
+#include "Nco.h"
 
 #define DECIMATORS_HB_FILTER_ORDER 64
+#define DECIMATORS_HB_FILTER_ORDERS DECIMATORS_HB_FILTER_ORDER // orders from the 1st stage, the last one is used by the next stages
+#define DECIMATORS_MAX_STAGES 6
+#define DECIMATORS_S16_MAX_BITS 14 // largest input sample size of a stage run on 16 bit samples
+#define DECIMATORS_CHUNK 4096 // input samples widened to 32 bits per pass (multiple of 64)
+#define DECIMATORS_MIX_EXTRA_BITS 2 // fractional bits kept from the mixer output when there is room
 
 class Decimators
 {
 public:
 	static void decimate1(unsigned int& sampleSize, IQSampleVector& inout);
-	static void decimate2_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	static void decimate2_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate2_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	static void decimate4_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	static void decimate4_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate4_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate8_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate8_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate8_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate16_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate16_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate16_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate32_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate32_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate32_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate64_inf(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate64_sup(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
-	void decimate64_cen(unsigned int& sampleSize, const IQSampleVector& in, IQSampleVector& out);
+	static void decimate1(unsigned int sampleSize, const IQSample *in, IQSample *out, std::size_t len);
+	static void decimate2_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	static void decimate2_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate2_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	static void decimate4_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	static void decimate4_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate4_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate8_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate8_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate8_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate16_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate16_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate16_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate32_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate32_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate32_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate64_inf(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate64_sup(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate64_cen(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	void decimate_mixed(unsigned int log2Decim, unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+
+	/** Oscillator the input is multiplied by in decimate_mixed */
+	Nco& mixer() { return m_nco; }
 
 private:
-#if defined(USE_SSE4_1)
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator2;  // 1st stages
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator4;  // 2nd stages
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator8;  // 3rd stages
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator16; // 4th stages
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator32; // 5th stages
-	IntHalfbandFilterEO1<DECIMATORS_HB_FILTER_ORDER> m_decimator64; // 6th stages
-#else
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator2;  // 1st stages
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator4;  // 2nd stages
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator8;  // 3rd stages
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator16; // 4th stages
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator32; // 5th stages
-    IntHalfbandFilterDB<DECIMATORS_HB_FILTER_ORDER> m_decimator64; // 6th stages
-#endif
+	HBFilterCascade<DECIMATORS_MAX_STAGES, DECIMATORS_HB_FILTER_ORDERS> m_stages;
+	Nco m_nco;
+
+	void decimate_cen(unsigned int log2Decim, unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out, bool mix = false);
+	void decimate_shifted(unsigned int log2Decim, bool sup, unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+	static unsigned int stages16(unsigned int sampleSize, unsigned int nbStages);
 };
 
 #endif /* INCLUDE_DECIMATORS_H_ */
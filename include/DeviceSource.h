@@ -33,6 +33,11 @@
 #include "DataBuffer.h"
 #include "SDRDaemon.h"
 
+/** Duration of samples held by the device transfers in flight when a latency is targeted */
+#define DEVICESOURCE_INFLIGHT_MS 100
+/** Blocks queued at most by sources running as fast as possible into an unbounded buffer */
+#define DEVICESOURCE_MAX_QUEUED_BLOCKS 4
+
 class Downsampler;
 
 class DeviceSource
@@ -42,10 +47,13 @@ public:
 	    m_decim(0),
 	    m_nbFECBlocks(1),
         m_txDelay(0),
+        m_latencyMs(0),
 		m_fcPos(2),
 		m_buf(0),
         m_stop_flag(0),
-		m_downsampler(0)
+		m_downsampler(0),
+		m_normalize(false),
+		m_sampleCount(0)
     {
         m_nnReceiver = nn_socket(AF_SP, NN_PAIR);
         assert(m_nnReceiver != -1);
@@ -84,6 +92,20 @@ public:
     /** Return sample size in bits */
     virtual std::uint32_t get_sample_bits() = 0;
 
+    /** Return true if the device can normalize samples to 16 bits while converting them */
+    virtual bool can_normalize() const { return false; }
+
+    /**
+     * Allow samples to be normalized to 16 bits (shifted left by 16 - get_sample_bits())
+     * during conversion so that they need no rescaling when the associated downsampler
+     * neither decimates nor resamples. The device thread follows the downsampler
+     * configuration and gives the shift applied to each block in its stamp.
+     */
+    void set_normalize(bool normalize)
+    {
+        m_normalize = normalize && can_normalize();
+    }
+
     /** Return current sample frequency in Hz. */
     virtual std::uint32_t get_sample_rate() = 0;
 
@@ -108,6 +130,12 @@ public:
         return m_txDelay;
     }
 
+    /** Return target latency of device transfers in ms or 0 for the device defaults */
+    unsigned int get_latency_ms() const
+    {
+        return m_latencyMs;
+    }
+
     /** Print current parameters specific to device type */
     virtual void print_specific_parms() = 0;
 
@@ -142,12 +170,81 @@ protected:
     unsigned int          m_decim;
     unsigned int          m_nbFECBlocks;
     unsigned int          m_txDelay;
+    unsigned int          m_latencyMs;  //!< target duration of a device transfer. 0 for throughput optimized defaults
     int                   m_fcPos;
     DataBuffer<IQSample> *m_buf;
     std::atomic_bool     *m_stop_flag;
     Downsampler          *m_downsampler;
+    std::atomic_bool      m_normalize;  //!< normalize samples to 16 bits during conversion when only rescaling
     int                   m_nnReceiver; //!< nanomsg socket handle
+    std::uint64_t         m_sampleCount; //!< samples received from the device since start
 
+    /**
+     * Return the number of samples received in the target latency at the current
+     * sample rate rounded down to a multiple of quantum and bounded to
+     * [minSamples, maxSamples]. maxSamples is the throughput optimized size which
+     * is returned when no latency is targeted so the target only makes transfers
+     * smaller.
+     */
+    std::uint32_t latency_samples(std::uint32_t quantum, std::uint32_t minSamples, std::uint32_t maxSamples)
+    {
+        if (m_latencyMs == 0) {
+            return maxSamples;
+        }
+
+        std::uint64_t nbSamples = ((std::uint64_t) get_sample_rate() * m_latencyMs) / 1000;
+        nbSamples -= nbSamples % quantum;
+
+        return nbSamples < minSamples ? minSamples : nbSamples > maxSamples ? maxSamples : nbSamples;
+    }
+
+    /**
+     * Return the number of transfers of transferSamples samples to keep in flight
+     * so that they hold DEVICESOURCE_INFLIGHT_MS of samples, bounded to
+     * [minBuffers, maxBuffers]. Small transfers need more of them to ride out
+     * the scheduling hiccups of the thread handling them.
+     */
+    unsigned int latency_buffers(std::uint32_t transferSamples, unsigned int minBuffers, unsigned int maxBuffers)
+    {
+        std::uint64_t inflight = ((std::uint64_t) get_sample_rate() * DEVICESOURCE_INFLIGHT_MS) / 1000;
+        std::uint64_t nbBuffers = (inflight + transferSamples - 1) / transferSamples;
+
+        return nbBuffers < minBuffers ? minBuffers : nbBuffers > maxBuffers ? maxBuffers : nbBuffers;
+    }
+
+    /**
+     * Left shift that normalizes converted samples to 16 bits or 0 if not normalizing.
+     * Get it once per block and give the same value to the conversion and stamp_block.
+     */
+    unsigned int get_norm_shift();
+
+    /**
+     * Stamp a block of nbSamples just received from the device and count its
+     * samples. Call it first thing when the transfer is received with the
+     * normalization shift the block is converted with.
+     */
+    SampleStamp stamp_block(std::size_t nbSamples, unsigned int normShift = 0)
+    {
+        SampleStamp stamp = SampleStamp::received(m_sampleCount, nbSamples, get_sample_rate());
+        stamp.m_normShift = normShift;
+        m_sampleCount += nbSamples;
+        return stamp;
+    }
+
+
+    /**
+     * Push a block of a source running as fast as possible (no device pacing it):
+     * wait for the processing thread to make room in the buffer instead of having
+     * the overflow policy drop the block. The buffer holds at most its capacity or
+     * DEVICESOURCE_MAX_QUEUED_BLOCKS blocks when it is unbounded.
+     */
+    void push_waiting(IQSampleVector&& samples, const SampleStamp& stamp);
+
+    /**
+     * Wait until the processing thread has pulled all queued samples or is stopped.
+     * Return the number of samples pulled out of the nbPushed samples pushed.
+     */
+    std::uint64_t wait_consumed(std::uint64_t nbPushed);
 
     /** Configure device and prepare for streaming from parameters map */
     virtual bool configure(parsekv::pairs_type& m) = 0;
@@ -19,10 +19,16 @@
 #ifndef INCLUDE_DOWNSAMPLER_H_
 #define INCLUDE_DOWNSAMPLER_H_
 
+#include <vector>
+#include <atomic>
+
 #include "Decimators.h"
+#include "RationalResampler.h"
 #include "SDRDaemon.h"
 #include "parsekv.h"
 
+class WorkerPool;
+
 class Downsampler
 {
 public:
@@ -38,9 +44,11 @@ public:
 	 *
      * decim            :: log2 of decimation factor
      * fcpos            :: Position of center frequency
+     * nbThreads        :: Number of threads sharing the decimation of a block
 	 */
 	Downsampler(unsigned int decim = 0,
-			fcPos_t fcPos = FC_POS_CENTER);
+			fcPos_t fcPos = FC_POS_CENTER,
+			unsigned int nbThreads = 1);
 
 	/** Destroy Downsampler */
 	~Downsampler();
@@ -51,6 +59,32 @@ public:
 	/** Return log2 of decimation */
 	unsigned int getLog2Decimation() const { return m_decim; }
 
+	/**
+	 * Return frequency shift in Hz of the center of the decimated band relative to the
+	 * center of the band selected by the center frequency position. Always 0 without
+	 * decimation.
+	 */
+	int getFrequencyShift() const { return (m_decim > 0 ? (int) m_frequencyShift : 0); }
+
+	/** Return true if the decimated samples are resampled to an arbitrary output rate */
+	bool isResampling() const { return m_outputRateRequested != 0; }
+
+	/** Set sample rate of the input samples in S/s. Used to resample to the output rate. */
+	void setSampleRate(uint32_t sampleRate) { m_sampleRate = sampleRate; }
+
+	/** Return sample rate of the output samples of the last processed block in S/s */
+	uint32_t getOutputSampleRate() const { return m_outputRate; }
+
+	/** Return number of threads used for decimation */
+	unsigned int getNbThreads() const { return m_nbThreadsRequested; }
+
+	/**
+	 * Share the threads of pool with other downsamplers. Must be called before
+	 * the first block is processed. By default a private pool is created when
+	 * more than one thread is requested.
+	 */
+	void setWorkerPool(WorkerPool *pool) { m_pool = pool; }
+
     /**
      * Process samples.
      */
@@ -61,6 +95,11 @@ public:
      */
     void rescale(unsigned int& sampleSize, IQSampleVector& samples_inout);
 
+    /**
+     * Rescale len samples from in to out (out can be the payload of an UDP block)
+     */
+    void rescale(unsigned int sampleSize, const IQSample *in, IQSample *out, std::size_t len);
+
     /** State operator */
     operator bool() const
 	{
@@ -75,11 +114,66 @@ public:
         return ret;
     }
 
+    /**
+     * Decimate len samples with the given decimators state. Dispatches to the Decimators
+     * method matching log2 of decimation and center frequency position, or
+     * to the mixing decimation when mix is set in which case the band is
+     * centered on the frequency of the decimators mixer.
+     */
+    static void decimate(Decimators& decimators,
+            unsigned int decim,
+            fcPos_t fcPos,
+            unsigned int& sampleSize,
+            const IQSample *samples_in,
+            std::size_t len,
+            IQSampleVector& samples_out,
+            bool mix = false);
+
 private:
+    /**
+     * Part of an input block decimated by one thread. Except for the first one
+     * the input is the segment preceded by enough samples of the block to flush
+     * the filters history so that its output is the same as if the whole block
+     * was decimated in sequence. It is read in place from the input block.
+     */
+    struct Segment
+    {
+        Decimators     m_decimators;
+        IQSampleVector m_out;
+        unsigned int   m_sampleSize;
+        std::size_t    m_start;  //!< first sample of the segment in the input block
+        std::size_t    m_length; //!< number of samples of the segment
+        std::size_t    m_warmup; //!< number of samples preceding the segment in the input
+    };
+
     unsigned int m_decim;
     fcPos_t      m_fcPos;
     Decimators   m_decimators;
     std::string  m_error;
+
+    std::atomic_int           m_frequencyShift;      //!< set by configure, 0 for no mixing
+    std::atomic_uint          m_outputRateRequested; //!< set by configure, 0 for no resampling
+    std::atomic_uint          m_sampleRate;          //!< input sample rate, read by configure
+    uint32_t                  m_outputRate;          //!< output sample rate of the last block
+    RationalResampler         m_resampler;
+    IQSampleVector            m_decimated;           //!< halfband chain output when resampling
+
+    std::atomic_uint          m_nbThreadsRequested; //!< set by configure, applied on next block
+    unsigned int              m_nbThreads;          //!< number of segments: pool threads + calling thread
+    std::vector<Segment*>     m_segments;
+    WorkerPool               *m_pool;               //!< threads doing the segments other than the first
+    WorkerPool               *m_ownPool;            //!< pool created when none is shared
+    unsigned int              m_workDecim;          //!< decimation of the current block
+    fcPos_t                   m_workFcPos;          //!< center frequency position of the current block
+    bool                      m_workMix;            //!< mixing decimation of the current block
+    const IQSampleVector     *m_workIn;
+    IQSampleVector           *m_workOut;
+
+    void processParallel(unsigned int decim, fcPos_t fcPos, bool mix, unsigned int& sampleSize, const IQSampleVector& samples_in, IQSampleVector& samples_out);
+    void decimateSegment(unsigned int index);
+    void setMixerFrequency(fcPos_t fcPos, int frequencyShift);
+    void resample(uint32_t inputRate, uint32_t outputRate, const IQSampleVector& samples_in, IQSampleVector& samples_out);
+    void setSegments(unsigned int nbThreads);
 };
 
 #endif /* INCLUDE_DOWNSAMPLER_H_ */
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_HBFILTERCASCADE_H_
+#define INCLUDE_HBFILTERCASCADE_H_
+
+#include <stdint.h>
+#include "IntHalfbandFilterEO1.h"
+
+template<unsigned int Stages, uint32_t Order, uint32_t... Orders>
+class HBFilterCascade;
+
+/** Cascade following the first stage: drop the first order unless it is the last one */
+template<unsigned int Stages, uint32_t Order, uint32_t... Orders>
+struct HBFilterCascadeNext
+{
+    typedef HBFilterCascade<Stages - 1, Orders...> type;
+};
+
+template<unsigned int Stages, uint32_t Order>
+struct HBFilterCascadeNext<Stages, Order>
+{
+    typedef HBFilterCascade<Stages - 1, Order> type;
+};
+
+/**
+ * Chain of Stages halfband filter stages generated at compile time. Stage i uses
+ * the i-th filter order of Orders and the last order is used by all the stages
+ * after it, so HBFilterCascade<6, 64> is six stages of order 64 and
+ * HBFilterCascade<6, 64, 32, 16> is 64, 32 then 16 for the next four.
+ *
+ * Blocks go through the first nbStages stages one after the other using the block
+ * processing of the filters. Each stage keeps its own state across calls.
+ */
+template<unsigned int Stages, uint32_t Order, uint32_t... Orders>
+class HBFilterCascade
+{
+public:
+    static const unsigned int stages = Stages;
+
+    /**
+     * Decimate nbSamples interleaved I/Q samples in place by 2^nbStages. nbSamples is a multiple
+     * of 2^nbStages. The first stages are skipped when the samples already went through them.
+     */
+    void decimate(unsigned int nbStages, int32_t *buf, unsigned int nbSamples, unsigned int first = 0)
+    {
+        if (first > 0) {
+            m_next.decimate(nbStages - 1, buf, nbSamples, first - 1);
+        }
+        else if (nbStages > 0)
+        {
+            m_filter.myDecimateBlock(buf, buf, nbSamples);
+            m_next.decimate(nbStages - 1, buf, nbSamples / 2);
+        }
+    }
+
+    /**
+     * Decimate nbSamples 16 bit interleaved I/Q samples by 2^nbStages (at least 1) from in to
+     * out then in place in out. The output of each stage must fit in 16 bits. Continue with
+     * the 32 bit decimate skipping these stages.
+     */
+    void decimate(unsigned int nbStages, const int16_t *in, int16_t *out, unsigned int nbSamples)
+    {
+        if (nbStages > 0)
+        {
+            m_filter.myDecimateBlock(in, out, nbSamples);
+            m_next.decimate(nbStages - 1, out, out, nbSamples / 2);
+        }
+    }
+
+    /**
+     * Interpolate nbSamples interleaved I/Q samples of buf by 2^nbStages using work as
+     * the other buffer of each stage. Both are large enough for the interpolated samples.
+     * Return the buffer holding the result.
+     */
+    int32_t *interpolate(unsigned int nbStages, int32_t *buf, int32_t *work, unsigned int nbSamples)
+    {
+        if (nbStages == 0) {
+            return buf;
+        }
+
+        m_filter.myInterpolateBlock(buf, work, nbSamples);
+        return m_next.interpolate(nbStages - 1, work, buf, 2 * nbSamples);
+    }
+
+private:
+    IntHalfbandFilterEO1<Order> m_filter;
+    typename HBFilterCascadeNext<Stages, Order, Orders...>::type m_next;
+};
+
+/** End of the chain */
+template<uint32_t Order, uint32_t... Orders>
+class HBFilterCascade<0, Order, Orders...>
+{
+public:
+    static const unsigned int stages = 0;
+
+    void decimate(unsigned int, int32_t *, unsigned int, unsigned int = 0) {}
+    void decimate(unsigned int, const int16_t *, int16_t *, unsigned int) {}
+    int32_t *interpolate(unsigned int, int32_t *buf, int32_t *, unsigned int) { return buf; }
+};
+
+#endif /* INCLUDE_HBFILTERCASCADE_H_ */
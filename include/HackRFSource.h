@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <mutex>
 #include "libhackrf/hackrf.h"
 
 #include "DeviceSource.h"
@@ -41,6 +42,9 @@ public:
     /** Return sample size in bits */
     virtual std::uint32_t get_sample_bits() { return 8; }
 
+    /** Samples are normalized by the conversion kernel */
+    virtual bool can_normalize() const { return true; }
+
     /** Return current sample frequency in Hz. */
     virtual std::uint32_t get_sample_rate();
 
@@ -91,7 +95,15 @@ private:
 
     void callback(const signed char* buf, int len);
     static int rx_callback(hackrf_transfer* transfer);
-    static void run(hackrf_device* dev, std::atomic_bool *stop_flag);
+    static void run(HackRFSource *source);
+
+    /**
+     * The library is initialized by the first user (device or device list) and
+     * left by the last one so that devices stay usable while others are opened
+     * or closed.
+     */
+    static hackrf_error library_init();
+    static hackrf_error library_exit();
 
     struct hackrf_device* m_dev;
     uint32_t m_sampleRate;
@@ -104,7 +116,9 @@ private:
     bool m_biasAnt;
     bool m_running;
     std::thread *m_thread;
-    static HackRFSource *m_this;
+    bool m_libraryInit; //!< this instance counts as a library user
+    static std::mutex m_libraryMutex;
+    static int m_libraryUsers;
     static const std::vector<int> m_lgains;
     static const std::vector<int> m_vgains;
     static const std::vector<int> m_bwfilt;
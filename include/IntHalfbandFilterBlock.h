@@ -0,0 +1,719 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_INTHALFBANDFILTERBLOCK_H_
+#define INCLUDE_INTHALFBANDFILTERBLOCK_H_
+
+#include <stdint.h>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HBFILTERBLOCK_NEON
+#endif
+
+#include "HBFilterTraits.h"
+#include "CpuFeatures.h"
+
+#define HBFILTER_BLOCK_CHUNK 256 // output samples computed per pass
+
+/**
+ * Block processing shared by the halfband filter classes.
+ *
+ * The filter state is handed over as a linear history of the last input samples,
+ * oldest first, I and Q interleaved. Each pass copies a chunk of input behind the
+ * history then runs one tap at a time over all the outputs of the chunk. Since I
+ * and Q are interleaved the same way in input and output every inner loop is a
+ * plain contiguous loop over 32 bit integers that the compiler vectorizes.
+ *
+ * The arithmetic is the one of the per sample filters term for term so the
+ * results are bit identical.
+ *
+ * The filter kernel is selected on first use from the instruction sets of the
+ * CPU: AVX-512, AVX2 or SSE4.1 on x86 and NEON on ARM when built with NEON
+ * support keep the accumulators in registers across all taps, else the plain
+ * loops vectorized for the build target are used.
+ *
+ * Decimation can also work on 16 bit samples. The products of the two symmetric
+ * samples of a tap are added into 32 bit accumulators with one multiply-add
+ * instruction (pmaddwd on x86, vmlal on ARM) handling twice the samples of a 32 bit
+ * multiply. The sum is the same so the results are bit identical as long as the
+ * output fits in 16 bits. Outputs saturate otherwise. As the gain of the filters
+ * on any signal is less than 4 this is guaranteed for inputs of at most 14 bits.
+ */
+template<uint32_t HBFilterOrder>
+class IntHalfbandFilterBlock
+{
+public:
+    static const int order = HBFIRFilterTraits<HBFilterOrder>::hbOrder;
+    static const int shift = HBFIRFilterTraits<HBFilterOrder>::hbShift - 1; // do not loose the gained bit
+    static const int decimHistory = order - 2;    //!< input samples kept between decimation blocks
+    static const int interpHistory = order/2 - 1; //!< input samples kept between interpolation blocks
+
+    /**
+     * Decimate nbSamples (even) input samples into nbSamples/2 output samples.
+     * Input sample pairs are split in even (first) and odd (second) samples.
+     * The symmetric taps apply to the odd samples when tapsOdd is true and to the even
+     * samples otherwise. The center tap applies to the other kind of samples delayed
+     * by centerDelay pairs from the newest and bias is added to it before scaling.
+     * out may be the same as in.
+     */
+    static void decimate(
+            int32_t *history,
+            const int32_t *in,
+            int32_t *out,
+            unsigned int nbSamples,
+            bool tapsOdd,
+            int centerDelay,
+            int32_t bias)
+    {
+        const int h = decimHistory/2; // pairs of history
+        int32_t even[2*(h + HBFILTER_BLOCK_CHUNK)];
+        int32_t odd[2*(h + HBFILTER_BLOCK_CHUNK)];
+        const int32_t *taps = tapsOdd ? odd : even;
+        const int32_t *center = (tapsOdd ? even : odd) + 2*(order/2 - 1 - centerDelay);
+
+        for (int j = 0; j < h; j++)
+        {
+            even[2*j]   = history[4*j];
+            even[2*j+1] = history[4*j+1];
+            odd[2*j]    = history[4*j+2];
+            odd[2*j+1]  = history[4*j+3];
+        }
+
+        unsigned int nbOut = nbSamples / 2;
+
+        while (nbOut > 0)
+        {
+            int n = nbOut < HBFILTER_BLOCK_CHUNK ? nbOut : HBFILTER_BLOCK_CHUNK;
+
+            for (int k = 0; k < n; k++)
+            {
+                even[2*(h+k)]   = in[4*k];
+                even[2*(h+k)+1] = in[4*k+1];
+                odd[2*(h+k)]    = in[4*k+2];
+                odd[2*(h+k)+1]  = in[4*k+3];
+            }
+
+            kernel()(taps, center, bias, out, 2*n);
+
+            std::memmove(even, &even[2*n], 2*h*sizeof(int32_t));
+            std::memmove(odd, &odd[2*n], 2*h*sizeof(int32_t));
+            in += 4*n;
+            out += 2*n;
+            nbOut -= n;
+        }
+
+        for (int j = 0; j < h; j++)
+        {
+            history[4*j]   = even[2*j];
+            history[4*j+1] = even[2*j+1];
+            history[4*j+2] = odd[2*j];
+            history[4*j+3] = odd[2*j+1];
+        }
+    }
+
+    /**
+     * Same as decimate on 16 bit samples with 16 bit history. Outputs that do not fit
+     * in 16 bits saturate.
+     */
+    static void decimate16(
+            int16_t *history,
+            const int16_t *in,
+            int16_t *out,
+            unsigned int nbSamples,
+            bool tapsOdd,
+            int centerDelay,
+            int32_t bias)
+    {
+        const int h = decimHistory/2; // pairs of history
+        int16_t even[2*(h + HBFILTER_BLOCK_CHUNK)];
+        int16_t odd[2*(h + HBFILTER_BLOCK_CHUNK)];
+        const int16_t *taps = tapsOdd ? odd : even;
+        const int16_t *center = (tapsOdd ? even : odd) + 2*(order/2 - 1 - centerDelay);
+
+        for (int j = 0; j < h; j++)
+        {
+            even[2*j]   = history[4*j];
+            even[2*j+1] = history[4*j+1];
+            odd[2*j]    = history[4*j+2];
+            odd[2*j+1]  = history[4*j+3];
+        }
+
+        unsigned int nbOut = nbSamples / 2;
+
+        while (nbOut > 0)
+        {
+            int n = nbOut < HBFILTER_BLOCK_CHUNK ? nbOut : HBFILTER_BLOCK_CHUNK;
+
+            for (int k = 0; k < n; k++)
+            {
+                even[2*(h+k)]   = in[4*k];
+                even[2*(h+k)+1] = in[4*k+1];
+                odd[2*(h+k)]    = in[4*k+2];
+                odd[2*(h+k)+1]  = in[4*k+3];
+            }
+
+            kernel16()(taps, center, bias, out, 2*n);
+
+            std::memmove(even, &even[2*n], 2*h*sizeof(int16_t));
+            std::memmove(odd, &odd[2*n], 2*h*sizeof(int16_t));
+            in += 4*n;
+            out += 2*n;
+            nbOut -= n;
+        }
+
+        for (int j = 0; j < h; j++)
+        {
+            history[4*j]   = even[2*j];
+            history[4*j+1] = even[2*j+1];
+            history[4*j+2] = odd[2*j];
+            history[4*j+3] = odd[2*j+1];
+        }
+    }
+
+    /**
+     * Interpolate nbSamples input samples into 2*nbSamples output samples.
+     * The first sample of each output pair is the input delayed to the center tap
+     * and the second one is calculated with the filter. out must not overlap in.
+     */
+    static void interpolate(
+            int32_t *history,
+            const int32_t *in,
+            int32_t *out,
+            unsigned int nbSamples)
+    {
+        const int h = interpHistory;
+        int32_t samples[2*(h + HBFILTER_BLOCK_CHUNK)];
+        int32_t acc[2*HBFILTER_BLOCK_CHUNK];
+
+        std::memcpy(samples, history, 2*h*sizeof(int32_t));
+
+        while (nbSamples > 0)
+        {
+            int n = nbSamples < HBFILTER_BLOCK_CHUNK ? nbSamples : HBFILTER_BLOCK_CHUNK;
+
+            std::memcpy(&samples[2*h], in, 2*n*sizeof(int32_t));
+            kernel()(samples, 0, 0, acc, 2*n);
+
+            const int32_t *delayed = &samples[2*(order/4 - 1)];
+
+            for (int k = 0; k < n; k++)
+            {
+                out[4*k]   = delayed[2*k];
+                out[4*k+1] = delayed[2*k+1];
+                out[4*k+2] = acc[2*k];
+                out[4*k+3] = acc[2*k+1];
+            }
+
+            std::memmove(samples, &samples[2*n], 2*h*sizeof(int32_t));
+            in += 2*n;
+            out += 4*n;
+            nbSamples -= n;
+        }
+
+        std::memcpy(history, samples, 2*h*sizeof(int32_t));
+    }
+
+    /** Return name of the filter kernel in use */
+    static const char *kernelName()
+    {
+        kernel();
+        return name();
+    }
+
+    /** Return name of the 16 bit filter kernel in use */
+    static const char *kernel16Name()
+    {
+        kernel16();
+        return name16();
+    }
+
+private:
+    /**
+     * Calculate len interleaved I/Q values of output. taps starts at the oldest sample
+     * used by the first output. When center is not null the center tap is applied
+     * to it with bias added first.
+     */
+    typedef void (*Kernel)(const int32_t *taps, const int32_t *center, int32_t bias, int32_t *out, int len);
+
+    static Kernel kernel()
+    {
+        static const Kernel selected = select();
+        return selected;
+    }
+
+    static const char *&name()
+    {
+        static const char *kernelName = "generic";
+        return kernelName;
+    }
+
+    static Kernel select()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (CpuFeatures::hasAVX512F())
+        {
+            name() = "avx512";
+            return firAVX512;
+        }
+
+        if (CpuFeatures::hasAVX2())
+        {
+            name() = "avx2";
+            return firAVX2;
+        }
+
+        if (CpuFeatures::hasSSE41())
+        {
+            name() = "sse4.1";
+            return firSSE41;
+        }
+#elif defined(HBFILTERBLOCK_NEON)
+        if (CpuFeatures::hasNEON())
+        {
+            name() = "neon";
+            return firNEON;
+        }
+#endif
+        name() = "generic";
+        return firGeneric;
+    }
+
+    /** Same as Kernel on 16 bit samples */
+    typedef void (*Kernel16)(const int16_t *taps, const int16_t *center, int32_t bias, int16_t *out, int len);
+
+    static Kernel16 kernel16()
+    {
+        static const Kernel16 selected = select16();
+        return selected;
+    }
+
+    static const char *&name16()
+    {
+        static const char *kernelName = "generic";
+        return kernelName;
+    }
+
+    static Kernel16 select16()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (CpuFeatures::hasAVX512BW())
+        {
+            name16() = "avx512";
+            return fir16AVX512;
+        }
+
+        if (CpuFeatures::hasAVX2())
+        {
+            name16() = "avx2";
+            return fir16AVX2;
+        }
+
+        if (CpuFeatures::hasSSE2())
+        {
+            name16() = "sse2";
+            return fir16SSE2;
+        }
+#elif defined(HBFILTERBLOCK_NEON)
+        if (CpuFeatures::hasNEON())
+        {
+            name16() = "neon";
+            return fir16NEON;
+        }
+#endif
+        name16() = "generic";
+        return fir16Generic;
+    }
+
+    static void firGeneric(
+            const int32_t * __restrict__ taps,
+            const int32_t * __restrict__ center,
+            int32_t bias,
+            int32_t * __restrict__ out,
+            int len)
+    {
+        if (center)
+        {
+            for (int m = 0; m < len; m++) {
+                out[m] = (center[m] + bias) << shift;
+            }
+        }
+        else
+        {
+            for (int m = 0; m < len; m++) {
+                out[m] = 0;
+            }
+        }
+
+        for (int i = 0; i < order/4; i++)
+        {
+            const int32_t c = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i];
+            const int32_t *a = &taps[2*(order/2 - 1 - i)];
+            const int32_t *b = &taps[2*i];
+
+            for (int m = 0; m < len; m++) {
+                out[m] += (a[m] + b[m]) * c;
+            }
+        }
+
+        for (int m = 0; m < len; m++) {
+            out[m] >>= shift;
+        }
+    }
+
+    static void fir16Generic(
+            const int16_t * __restrict__ taps,
+            const int16_t * __restrict__ center,
+            int32_t bias,
+            int16_t * __restrict__ out,
+            int len)
+    {
+        int32_t acc[2*HBFILTER_BLOCK_CHUNK];
+
+        for (int m = 0; m < len; m++) {
+            acc[m] = center ? (center[m] + bias) << shift : 0;
+        }
+
+        for (int i = 0; i < order/4; i++)
+        {
+            const int32_t c = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i];
+            const int16_t *a = &taps[2*(order/2 - 1 - i)];
+            const int16_t *b = &taps[2*i];
+
+            for (int m = 0; m < len; m++) {
+                acc[m] += (a[m] + b[m]) * c;
+            }
+        }
+
+        for (int m = 0; m < len; m++)
+        {
+            int32_t v = acc[m] >> shift;
+            out[m] = v < -32768 ? -32768 : v > 32767 ? 32767 : v;
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    /**
+     * Coefficient of sample j of the order/2 samples spanned by the taps, the odd
+     * coefficients in the high half, for one pmaddwd over samples j and j+1.
+     */
+    static int32_t coeffPair(int j)
+    {
+        const int q = order/4;
+        int32_t c0 = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[j < q ? j : order/2 - 1 - j];
+        int32_t c1 = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[j + 1 < q ? j + 1 : order/2 - 2 - j];
+        return (int32_t) (((uint32_t) c1 << 16) | ((uint32_t) c0 & 0xFFFF));
+    }
+
+    /** Lay out the first nbPairs samples each followed by the next one. Reads nbPairs + 1 samples. */
+    __attribute__((target("sse2")))
+    static void makePairs(const int16_t *taps, int16_t *pairs, int nbPairs)
+    {
+        int k = 0;
+
+        for (; k + 4 <= nbPairs; k += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) &taps[2*k]);
+            __m128i w = _mm_loadu_si128((const __m128i *) &taps[2*k + 2]);
+            _mm_storeu_si128((__m128i *) &pairs[4*k], _mm_unpacklo_epi16(v, w));
+            _mm_storeu_si128((__m128i *) &pairs[4*k + 8], _mm_unpackhi_epi16(v, w));
+        }
+
+        for (; k < nbPairs; k++)
+        {
+            pairs[4*k]   = taps[2*k];
+            pairs[4*k+1] = taps[2*k + 2];
+            pairs[4*k+2] = taps[2*k + 1];
+            pairs[4*k+3] = taps[2*k + 3];
+        }
+    }
+
+    /**
+     * Both 16 bit kernels first lay out each sample next to the following one as
+     * (I[k], I[k+1], Q[k], Q[k+1]) so that a single pmaddwd applies two consecutive
+     * taps to I and Q of an output sample. Each pair of taps then costs one load, one
+     * multiply-add and one add for twice as many outputs as the 32 bit kernels.
+     */
+    __attribute__((target("sse2")))
+    static void fir16SSE2(const int16_t *taps, const int16_t *center, int32_t bias, int16_t *out, int len)
+    {
+        int16_t pairs[4*(HBFILTER_BLOCK_CHUNK + order/2)];
+        const __m128i vbias = _mm_set1_epi32(bias);
+        const __m128i zero = _mm_setzero_si128();
+        int m = 0;
+
+        makePairs(taps, pairs, len/2 + order/2 - 2);
+
+        for (; m + 8 <= len; m += 8)
+        {
+            __m128i acc0 = _mm_setzero_si128();
+            __m128i acc1 = _mm_setzero_si128();
+
+            if (center)
+            {
+                __m128i c = _mm_loadu_si128((const __m128i *) &center[m]);
+                acc0 = _mm_slli_epi32(_mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(zero, c), 16), vbias), shift);
+                acc1 = _mm_slli_epi32(_mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(zero, c), 16), vbias), shift);
+            }
+
+            for (int j = 0; j < order/2; j += 2)
+            {
+                __m128i c = _mm_set1_epi32(coeffPair(j));
+                acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &pairs[2*(m + 2*j)]), c));
+                acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &pairs[2*(m + 2*j) + 8]), c));
+            }
+
+            _mm_storeu_si128((__m128i *) &out[m], _mm_packs_epi32(_mm_srai_epi32(acc0, shift), _mm_srai_epi32(acc1, shift)));
+        }
+
+        fir16Generic(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    __attribute__((target("avx2")))
+    static void fir16AVX2(const int16_t *taps, const int16_t *center, int32_t bias, int16_t *out, int len)
+    {
+        int16_t pairs[4*(HBFILTER_BLOCK_CHUNK + order/2)];
+        const __m256i vbias = _mm256_set1_epi32(bias);
+        int m = 0;
+
+        makePairs(taps, pairs, len/2 + order/2 - 2);
+
+        for (; m + 16 <= len; m += 16)
+        {
+            __m256i acc0 = _mm256_setzero_si256();
+            __m256i acc1 = _mm256_setzero_si256();
+
+            if (center)
+            {
+                acc0 = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &center[m])), vbias), shift);
+                acc1 = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &center[m + 8])), vbias), shift);
+            }
+
+            for (int j = 0; j < order/2; j += 2)
+            {
+                __m256i c = _mm256_set1_epi32(coeffPair(j));
+                acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) &pairs[2*(m + 2*j)]), c));
+                acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) &pairs[2*(m + 2*j) + 16]), c));
+            }
+
+            // packs works within 128 bit lanes: put the samples back in order
+            __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(acc0, shift), _mm256_srai_epi32(acc1, shift));
+            _mm256_storeu_si256((__m256i *) &out[m], _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+
+        fir16Generic(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    __attribute__((target("avx512bw")))
+    static void fir16AVX512(const int16_t *taps, const int16_t *center, int32_t bias, int16_t *out, int len)
+    {
+        // zero masking forms with all lanes selected as in firAVX512
+        const __mmask16 all = 0xFFFF;
+        int16_t pairs[4*(HBFILTER_BLOCK_CHUNK + order/2)];
+        const __m512i vbias = _mm512_set1_epi32(bias);
+        const __m512i order64 = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+        int m = 0;
+
+        makePairs(taps, pairs, len/2 + order/2 - 2);
+
+        for (; m + 32 <= len; m += 32)
+        {
+            __m512i acc0 = _mm512_setzero_si512();
+            __m512i acc1 = _mm512_setzero_si512();
+
+            if (center)
+            {
+                acc0 = _mm512_maskz_slli_epi32(all, _mm512_add_epi32(_mm512_maskz_cvtepi16_epi32(all, _mm256_loadu_si256((const __m256i *) &center[m])), vbias), shift);
+                acc1 = _mm512_maskz_slli_epi32(all, _mm512_add_epi32(_mm512_maskz_cvtepi16_epi32(all, _mm256_loadu_si256((const __m256i *) &center[m + 16])), vbias), shift);
+            }
+
+            for (int j = 0; j < order/2; j += 2)
+            {
+                __m512i c = _mm512_set1_epi32(coeffPair(j));
+                acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(_mm512_loadu_si512(&pairs[2*(m + 2*j)]), c));
+                acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(_mm512_loadu_si512(&pairs[2*(m + 2*j) + 32]), c));
+            }
+
+            __m512i packed = _mm512_packs_epi32(_mm512_maskz_srai_epi32(all, acc0, shift), _mm512_maskz_srai_epi32(all, acc1, shift));
+            _mm512_storeu_si512(&out[m], _mm512_maskz_permutexvar_epi64(0xFF, order64, packed));
+        }
+
+        fir16Generic(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void firSSE41(const int32_t *taps, const int32_t *center, int32_t bias, int32_t *out, int len)
+    {
+        const __m128i vbias = _mm_set1_epi32(bias);
+        int m = 0;
+
+        for (; m + 4 <= len; m += 4)
+        {
+            __m128i acc = _mm_setzero_si128();
+
+            if (center) {
+                acc = _mm_slli_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *) &center[m]), vbias), shift);
+            }
+
+            for (int i = 0; i < order/4; i++)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *) &taps[2*(order/2 - 1 - i) + m]);
+                __m128i b = _mm_loadu_si128((const __m128i *) &taps[2*i + m]);
+                __m128i c = _mm_set1_epi32(HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i]);
+                acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_add_epi32(a, b), c));
+            }
+
+            _mm_storeu_si128((__m128i *) &out[m], _mm_srai_epi32(acc, shift));
+        }
+
+        firGeneric(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    __attribute__((target("avx2")))
+    static void firAVX2(const int32_t *taps, const int32_t *center, int32_t bias, int32_t *out, int len)
+    {
+        const __m256i vbias = _mm256_set1_epi32(bias);
+        int m = 0;
+
+        for (; m + 8 <= len; m += 8)
+        {
+            __m256i acc = _mm256_setzero_si256();
+
+            if (center) {
+                acc = _mm256_slli_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i *) &center[m]), vbias), shift);
+            }
+
+            for (int i = 0; i < order/4; i++)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i *) &taps[2*(order/2 - 1 - i) + m]);
+                __m256i b = _mm256_loadu_si256((const __m256i *) &taps[2*i + m]);
+                __m256i c = _mm256_set1_epi32(HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i]);
+                acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_add_epi32(a, b), c));
+            }
+
+            _mm256_storeu_si256((__m256i *) &out[m], _mm256_srai_epi32(acc, shift));
+        }
+
+        firGeneric(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    __attribute__((target("avx512f")))
+    static void firAVX512(const int32_t *taps, const int32_t *center, int32_t bias, int32_t *out, int len)
+    {
+        // The zero masking forms are used because the plain shifts of GCC 12 merge into an
+        // undefined vector and trigger -Wmaybe-uninitialized. All lanes are kept.
+        const __mmask16 all = 0xFFFF;
+        const __m512i vbias = _mm512_set1_epi32(bias);
+        int m = 0;
+
+        for (; m + 16 <= len; m += 16)
+        {
+            __m512i acc = _mm512_setzero_si512();
+
+            if (center) {
+                acc = _mm512_maskz_slli_epi32(all, _mm512_add_epi32(_mm512_loadu_si512(&center[m]), vbias), shift);
+            }
+
+            for (int i = 0; i < order/4; i++)
+            {
+                __m512i a = _mm512_loadu_si512(&taps[2*(order/2 - 1 - i) + m]);
+                __m512i b = _mm512_loadu_si512(&taps[2*i + m]);
+                __m512i c = _mm512_set1_epi32(HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i]);
+                acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(_mm512_add_epi32(a, b), c));
+            }
+
+            _mm512_storeu_si512(&out[m], _mm512_maskz_srai_epi32(all, acc, shift));
+        }
+
+        firGeneric(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+#endif
+
+#if defined(HBFILTERBLOCK_NEON)
+    /** Two accumulators per pass so that in order cores (Cortex-A53) overlap the multiply-accumulates */
+    static void firNEON(const int32_t *taps, const int32_t *center, int32_t bias, int32_t *out, int len)
+    {
+        const int32x4_t vbias = vdupq_n_s32(bias);
+        int m = 0;
+
+        for (; m + 8 <= len; m += 8)
+        {
+            int32x4_t acc0 = vdupq_n_s32(0);
+            int32x4_t acc1 = vdupq_n_s32(0);
+
+            if (center)
+            {
+                acc0 = vshlq_n_s32(vaddq_s32(vld1q_s32(&center[m]), vbias), shift);
+                acc1 = vshlq_n_s32(vaddq_s32(vld1q_s32(&center[m+4]), vbias), shift);
+            }
+
+            for (int i = 0; i < order/4; i++)
+            {
+                const int32_t *a = &taps[2*(order/2 - 1 - i) + m];
+                const int32_t *b = &taps[2*i + m];
+                const int32_t c = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i];
+                acc0 = vmlaq_n_s32(acc0, vaddq_s32(vld1q_s32(a), vld1q_s32(b)), c);
+                acc1 = vmlaq_n_s32(acc1, vaddq_s32(vld1q_s32(a+4), vld1q_s32(b+4)), c);
+            }
+
+            vst1q_s32(&out[m], vshrq_n_s32(acc0, shift));
+            vst1q_s32(&out[m+4], vshrq_n_s32(acc1, shift));
+        }
+
+        firGeneric(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+
+    /** Widening multiply-accumulate of both ends of the tap into two accumulators of 4 samples */
+    static void fir16NEON(const int16_t *taps, const int16_t *center, int32_t bias, int16_t *out, int len)
+    {
+        const int32x4_t vbias = vdupq_n_s32(bias);
+        int m = 0;
+
+        for (; m + 8 <= len; m += 8)
+        {
+            int32x4_t acc0 = vdupq_n_s32(0);
+            int32x4_t acc1 = vdupq_n_s32(0);
+
+            if (center)
+            {
+                int16x8_t c = vld1q_s16(&center[m]);
+                acc0 = vshlq_n_s32(vaddq_s32(vmovl_s16(vget_low_s16(c)), vbias), shift);
+                acc1 = vshlq_n_s32(vaddq_s32(vmovl_s16(vget_high_s16(c)), vbias), shift);
+            }
+
+            for (int i = 0; i < order/4; i++)
+            {
+                int16x8_t a = vld1q_s16(&taps[2*(order/2 - 1 - i) + m]);
+                int16x8_t b = vld1q_s16(&taps[2*i + m]);
+                const int16_t c = HBFIRFilterTraits<HBFilterOrder>::hbCoeffs[i];
+                acc0 = vmlal_n_s16(vmlal_n_s16(acc0, vget_low_s16(a), c), vget_low_s16(b), c);
+                acc1 = vmlal_n_s16(vmlal_n_s16(acc1, vget_high_s16(a), c), vget_high_s16(b), c);
+            }
+
+            vst1q_s16(&out[m], vcombine_s16(vqmovn_s32(vshrq_n_s32(acc0, shift)), vqmovn_s32(vshrq_n_s32(acc1, shift))));
+        }
+
+        fir16Generic(&taps[m], center ? &center[m] : 0, bias, &out[m], len - m);
+    }
+#endif
+};
+
+#endif /* INCLUDE_INTHALFBANDFILTERBLOCK_H_ */
@@ -21,6 +21,7 @@
 
 #include <cstdint>
 #include "HBFilterTraits.h"
+#include "IntHalfbandFilterBlock.h"
 
 /** Slimmed out class from SDRangel's IntHalfbandFilter */
 template<uint32_t HBFilterOrder>
@@ -70,6 +71,61 @@ public:
         // second sample calculated with the filter
         doInterpolateFIR(x2, y2);
     }
+
+    /**
+     * Decimate nbSamples (even) interleaved I/Q samples into nbSamples/2 samples.
+     * Same as calling myDecimate on each pair. out may be the same as in.
+     */
+    void myDecimateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::decimHistory;
+        int32_t history[2*hsize];
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + m_size - hsize + k) % m_size;
+            history[2*k]   = m_samples[p][0];
+            history[2*k+1] = m_samples[p][1];
+        }
+
+        IntHalfbandFilterBlock<HBFilterOrder>::decimate(history, in, out, nbSamples,
+                true, HBFIRFilterTraits<HBFilterOrder>::hbOrder/4 - 1, 1);
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + m_size - hsize + k) % m_size;
+            m_samples[p][0] = m_samples[p + m_size][0] = history[2*k];
+            m_samples[p][1] = m_samples[p + m_size][1] = history[2*k+1];
+        }
+    }
+
+    /**
+     * Interpolate nbSamples interleaved I/Q samples into 2*nbSamples samples.
+     * Same as calling myInterpolate on each sample. out must not overlap in.
+     */
+    void myInterpolateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::interpHistory;
+        const int rsize = HBFIRFilterTraits<HBFilterOrder>::hbOrder/2;
+        int32_t history[2*hsize];
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            history[2*k]   = m_samples[p][0];
+            history[2*k+1] = m_samples[p][1];
+        }
+
+        IntHalfbandFilterBlock<HBFilterOrder>::interpolate(history, in, out, nbSamples);
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            m_samples[p][0] = m_samples[p + rsize][0] = history[2*k];
+            m_samples[p][1] = m_samples[p + rsize][1] = history[2*k+1];
+        }
+    }
+
 protected:
 	int32_t m_samples[2*(HBFIRFilterTraits<HBFilterOrder>::hbOrder - 1)][2]; // double buffer technique
 	int16_t m_ptr;
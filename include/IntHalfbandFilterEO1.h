@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include "HBFilterTraits.h"
 #include "IntHalfbandFilterEO1i.h"
+#include "IntHalfbandFilterBlock.h"
 
 template<uint32_t HBFilterOrder>
 class IntHalfbandFilterEO1 {
@@ -64,6 +65,59 @@ public:
         doInterpolateFIR(x2, y2);
     }
 
+    /**
+     * Decimate nbSamples (even) interleaved I/Q samples into nbSamples/2 samples.
+     * Same as calling myDecimate on each pair. out may be the same as in.
+     */
+    void myDecimateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        int32_t history[2*IntHalfbandFilterBlock<HBFilterOrder>::decimHistory];
+        loadDecimateHistory(history);
+        IntHalfbandFilterBlock<HBFilterOrder>::decimate(history, in, out, nbSamples,
+                true, HBFIRFilterTraits<HBFilterOrder>::hbOrder/4 - 1, 0);
+        storeDecimateHistory(history);
+    }
+
+    /**
+     * Same as above on 16 bit samples. The state is shared with the 32 bit version.
+     * Outputs saturate if they do not fit in 16 bits.
+     */
+    void myDecimateBlock(const int16_t *in, int16_t *out, unsigned int nbSamples)
+    {
+        int16_t history[2*IntHalfbandFilterBlock<HBFilterOrder>::decimHistory];
+        loadDecimateHistory(history);
+        IntHalfbandFilterBlock<HBFilterOrder>::decimate16(history, in, out, nbSamples,
+                true, HBFIRFilterTraits<HBFilterOrder>::hbOrder/4 - 1, 0);
+        storeDecimateHistory(history);
+    }
+
+    /**
+     * Interpolate nbSamples interleaved I/Q samples into 2*nbSamples samples.
+     * Same as calling myInterpolate on each sample. out must not overlap in.
+     */
+    void myInterpolateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::interpHistory;
+        const int rsize = HBFIRFilterTraits<HBFilterOrder>::hbOrder/2;
+        int32_t history[2*hsize];
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            history[2*k]   = m_samples[p][0];
+            history[2*k+1] = m_samples[p][1];
+        }
+
+        IntHalfbandFilterBlock<HBFilterOrder>::interpolate(history, in, out, nbSamples);
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            m_samples[p][0] = m_samples[p + rsize][0] = history[2*k];
+            m_samples[p][1] = m_samples[p + rsize][1] = history[2*k+1];
+        }
+    }
+
 protected:
     int32_t m_even[2][HBFIRFilterTraits<HBFilterOrder>::hbOrder]; // double buffer technique
     int32_t m_odd[2][HBFIRFilterTraits<HBFilterOrder>::hbOrder]; // double buffer technique
@@ -96,6 +150,42 @@ protected:
         m_ptr = (m_ptr + 1) % (2*m_size);
     }
 
+    /** Copy the last input samples from the ring, oldest first */
+    template<typename T>
+    void loadDecimateHistory(T *history)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::decimHistory;
+        int ptr = m_ptr;
+        m_ptr = (m_ptr + 2*m_size - hsize) % (2*m_size); // oldest sample of history
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int32_t (*samples)[HBFIRFilterTraits<HBFilterOrder>::hbOrder] = (m_ptr % 2) == 0 ? m_even : m_odd;
+            history[2*k]   = samples[0][m_ptr/2];
+            history[2*k+1] = samples[1][m_ptr/2];
+            advancePointer();
+        }
+
+        m_ptr = ptr;
+    }
+
+    /** Store the last input samples back in the ring. The pointer is unchanged. */
+    template<typename T>
+    void storeDecimateHistory(const T *history)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::decimHistory;
+        int ptr = m_ptr;
+        m_ptr = (m_ptr + 2*m_size - hsize) % (2*m_size);
+
+        for (int k = 0; k < hsize; k++)
+        {
+            storeSample(history[2*k], history[2*k+1]);
+            advancePointer();
+        }
+
+        m_ptr = ptr;
+    }
+
 
     void doFIR(int32_t *x, int32_t *y)
     {
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include "HBFilterTraits.h"
 #include "IntHalfbandFilterSTi.h"
+#include "IntHalfbandFilterBlock.h"
 
 template<uint32_t HBFilterOrder>
 class IntHalfbandFilterST {
@@ -63,6 +64,63 @@ public:
         doInterpolateFIR(x2, y2);
     }
 
+    /**
+     * Decimate nbSamples (even) interleaved I/Q samples into nbSamples/2 samples.
+     * Same as calling myDecimate on each pair. out may be the same as in.
+     */
+    void myDecimateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::decimHistory;
+        int32_t history[2*hsize];
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + m_size - hsize + k) % m_size;
+            history[2*k]   = m_samplesDB[p][0];
+            history[2*k+1] = m_samplesDB[p][1];
+        }
+
+        IntHalfbandFilterBlock<HBFilterOrder>::decimate(history, in, out, nbSamples,
+                false, HBFIRFilterTraits<HBFilterOrder>::hbOrder/4, 0);
+        int ptr = m_ptr;
+        m_ptr = (m_ptr + m_size - hsize) % m_size;
+
+        for (int k = 0; k < hsize; k++)
+        {
+            storeSample(history[2*k], history[2*k+1]);
+            advancePointer();
+        }
+
+        m_ptr = ptr;
+    }
+
+    /**
+     * Interpolate nbSamples interleaved I/Q samples into 2*nbSamples samples.
+     * Same as calling myInterpolate on each sample. out must not overlap in.
+     */
+    void myInterpolateBlock(const int32_t *in, int32_t *out, unsigned int nbSamples)
+    {
+        const int hsize = IntHalfbandFilterBlock<HBFilterOrder>::interpHistory;
+        const int rsize = HBFIRFilterTraits<HBFilterOrder>::hbOrder/2;
+        int32_t history[2*hsize];
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            history[2*k]   = m_samples[p][0];
+            history[2*k+1] = m_samples[p][1];
+        }
+
+        IntHalfbandFilterBlock<HBFilterOrder>::interpolate(history, in, out, nbSamples);
+
+        for (int k = 0; k < hsize; k++)
+        {
+            int p = (m_ptr + rsize - hsize + k) % rsize;
+            m_samples[p][0] = m_samples[p + rsize][0] = history[2*k];
+            m_samples[p][1] = m_samples[p + rsize][1] = history[2*k+1];
+        }
+    }
+
 protected:
     int32_t m_samplesDB[2*HBFilterOrder][2]; // double buffer technique with even/odd amnd I/Q stride
     int32_t m_samplesAligned[HBFilterOrder][2] __attribute__ ((aligned (16)));
@@ -168,6 +226,8 @@ IntHalfbandFilterST<HBFilterOrder>::IntHalfbandFilterST()
     {
         m_samplesDB[i][0] = 0;
         m_samplesDB[i][1] = 0;
+        m_samplesDB[i + m_size][0] = 0;
+        m_samplesDB[i + m_size][1] = 0;
         m_samples[i][0] = 0;
         m_samples[i][1] = 0;
     }
@@ -101,7 +101,7 @@ public:
         __m128i sh, sa, sb;
         int32_t sums[4] __attribute__ ((aligned (16)));
 
-        for (int i = 0; i < HBFIRFilterTraits<HBFilterOrder>::hbOrder / 4; i++)
+        for (int i = 0; i < HBFIRFilterTraits<HBFilterOrder>::hbOrder / 16; i++)
         {
             sh = _mm_set_epi32(h[4*i], h[4*i], h[4*i], h[4*i]);
             sa = _mm_loadu_si128((__m128i*) &(samples[a][0])); // Ei,Eq,Oi,Oq
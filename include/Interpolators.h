@@ -21,16 +21,13 @@
 #define INCLUDE_INTERPOLATORS_H_
 
 #include "SDRDaemon.h"
-
-#if defined(USE_SSE4_1)
-#include "IntHalfbandFilterEO1.h"
-#else
-#include "IntHalfbandFilterDB.h"
-#endif
+#include "HBFilterCascade.h"
 
 #define INTERPOLATORS_HB_FILTER_ORDER_FIRST  64
 #define INTERPOLATORS_HB_FILTER_ORDER_SECOND 32
 #define INTERPOLATORS_HB_FILTER_ORDER_NEXT   16
+#define INTERPOLATORS_MAX_STAGES 6
+#define INTERPOLATORS_CHUNK 2048 // output samples produced per pass (multiple of 64)
 
 class Interpolators
 {
@@ -43,21 +40,9 @@ public:
 	void interpolate64_cen(const IQSampleVector& in, IQSampleVector& out);
 
 private:
-#if defined(USE_SSE4_1)
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_FIRST> m_interpolator2;  // 1st stages
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_SECOND> m_interpolator4;  // 2nd stages
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator8;  // 3rd stages
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator16; // 4th stages
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator32; // 5th stages
-	IntHalfbandFilterEO1<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator64; // 6th stages
-#else
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_FIRST> m_interpolator2;  // 1st stages
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_SECOND> m_interpolator4;  // 2nd stages
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator8;  // 3rd stages
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator16; // 4th stages
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator32; // 5th stages
-    IntHalfbandFilterDB<INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_interpolator64; // 6th stages
-#endif
+	void interpolate_cen(unsigned int log2Interp, const IQSampleVector& in, IQSampleVector& out);
+
+	HBFilterCascade<INTERPOLATORS_MAX_STAGES, INTERPOLATORS_HB_FILTER_ORDER_FIRST, INTERPOLATORS_HB_FILTER_ORDER_SECOND, INTERPOLATORS_HB_FILTER_ORDER_NEXT> m_stages;
 };
 
 #endif /* INCLUDE_INTERPOLATORS_H_ */
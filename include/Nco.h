@@ -0,0 +1,206 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_NCO_H_
+#define INCLUDE_NCO_H_
+
+#include <cmath>
+#include <cstddef>
+
+/**
+ * Numerically controlled oscillator generating a complex exponential with an
+ * optional linear frequency sweep (chirp).
+ *
+ * Instead of calling cos and sin for every sample the oscillator runs lanes
+ * independent complex rotators each producing every lanes-th sample. The
+ * inner loop is a plain complex multiply over arrays of lanes floats which
+ * the compiler vectorizes for whatever SIMD the target has. The rotators are
+ * set again from the double precision phase accumulator every anchor_length
+ * samples so that the rounding errors of the recursion do not build up.
+ */
+class Nco
+{
+public:
+    static const unsigned int lanes = 8;
+    static const unsigned int anchor_length = 1024; //!< multiple of lanes
+    static const unsigned int mix_length = anchor_length; //!< samples generated at once by mix
+
+    Nco() :
+        m_phase(0.0),
+        m_dphi(0.0),
+        m_ddphi(0.0)
+    {}
+
+    /**
+     * Set frequency in Hz and sweep rate in Hz per second. The phase is kept
+     * so that changing frequency does not cause a discontinuity.
+     */
+    void setFrequency(double frequency, double sampleRate, double sweepRate = 0.0)
+    {
+        m_dphi = wrap(2.0 * M_PI * frequency / sampleRate);
+        m_ddphi = 2.0 * M_PI * sweepRate / (sampleRate * sampleRate);
+    }
+
+    void setPhase(double phase) { m_phase = wrap(phase); }
+    double getPhase() const { return m_phase; }
+
+    /** Return current frequency in Hz */
+    double getFrequency(double sampleRate) const { return m_dphi * sampleRate / (2.0 * M_PI); }
+
+    /** Add amplitude * exp(j*phase) of the next n samples to re and im */
+    void add(float *re, float *im, unsigned int n, float amplitude)
+    {
+        float zr[lanes], zi[lanes], wr[lanes], wi[lanes];
+
+        while (n > 0)
+        {
+            unsigned int len = n < anchor_length ? n : anchor_length;
+
+            // phase of sample k is phase + dphi*k + ddphi*k*k/2 thus lane k steps by
+            // lanes*dphi + ddphi*lanes*(lanes/2 + k) then its step grows by ddphi*lanes*lanes
+            for (unsigned int k = 0; k < lanes; k++)
+            {
+                double phase = m_phase + m_dphi * k + m_ddphi * k * k / 2.0;
+                double step = lanes * m_dphi + m_ddphi * lanes * (lanes / 2.0 + k);
+                zr[k] = amplitude * cos(phase);
+                zi[k] = amplitude * sin(phase);
+                wr[k] = cos(step);
+                wi[k] = sin(step);
+            }
+
+            unsigned int nbChunks = len / lanes;
+
+            if (m_ddphi == 0.0)
+            {
+                for (unsigned int c = 0; c < nbChunks; c++, re += lanes, im += lanes)
+                {
+                    for (unsigned int k = 0; k < lanes; k++)
+                    {
+                        re[k] += zr[k];
+                        im[k] += zi[k];
+                        float r = zr[k] * wr[k] - zi[k] * wi[k];
+                        zi[k] = zr[k] * wi[k] + zi[k] * wr[k];
+                        zr[k] = r;
+                    }
+                }
+            }
+            else
+            {
+                float cr = cos(m_ddphi * lanes * lanes);
+                float ci = sin(m_ddphi * lanes * lanes);
+
+                for (unsigned int c = 0; c < nbChunks; c++, re += lanes, im += lanes)
+                {
+                    for (unsigned int k = 0; k < lanes; k++)
+                    {
+                        re[k] += zr[k];
+                        im[k] += zi[k];
+                        float r = zr[k] * wr[k] - zi[k] * wi[k];
+                        zi[k] = zr[k] * wi[k] + zi[k] * wr[k];
+                        zr[k] = r;
+                        r = wr[k] * cr - wi[k] * ci;
+                        wi[k] = wr[k] * ci + wi[k] * cr;
+                        wr[k] = r;
+                    }
+                }
+            }
+
+            unsigned int tail = len - nbChunks * lanes; // only on the last run
+
+            for (unsigned int k = 0; k < tail; k++)
+            {
+                re[k] += zr[k];
+                im[k] += zi[k];
+            }
+
+            re += tail;
+            im += tail;
+            m_phase = wrap(m_phase + m_dphi * len + m_ddphi * len * (double) len / 2.0);
+            m_dphi = wrap(m_dphi + m_ddphi * len); // a sweep past Nyquist folds back to -Nyquist
+            n -= len;
+        }
+    }
+
+    /**
+     * Multiply the next n interleaved I/Q samples of in by amplitude * exp(j*phase)
+     * and store them in out rounded to the nearest integer. The oscillator is
+     * generated by add in blocks small enough to stay in L1 cache then applied
+     * with a plain complex multiply. The result must fit in the output type.
+     */
+    template<typename T, typename U>
+    void mix(const T *in, U *out, unsigned int n, float amplitude)
+    {
+        float zr[mix_length], zi[mix_length];
+
+        while (n > 0)
+        {
+            unsigned int len = n < mix_length ? n : mix_length;
+
+            for (unsigned int k = 0; k < len; k++)
+            {
+                zr[k] = 0.0f;
+                zi[k] = 0.0f;
+            }
+
+            add(zr, zi, len, amplitude);
+
+            for (unsigned int k = 0; k < len; k++)
+            {
+                float x = in[2*k];
+                float y = in[2*k+1];
+                float re = x * zr[k] - y * zi[k];
+                float im = x * zi[k] + y * zr[k];
+                out[2*k]   = (U) (re + (re < 0.0f ? -0.5f : 0.5f));
+                out[2*k+1] = (U) (im + (im < 0.0f ? -0.5f : 0.5f));
+            }
+
+            in += 2*len;
+            out += 2*len;
+            n -= len;
+        }
+    }
+
+    /**
+     * Advance the phase by n samples without generating them. The phase is stepped
+     * by anchor_length samples like add does so that it is exactly the one reached
+     * by generating the samples in runs starting on multiples of anchor_length.
+     */
+    void skip(std::size_t n)
+    {
+        while (n > 0)
+        {
+            double len = n < anchor_length ? n : anchor_length;
+            m_phase = wrap(m_phase + m_dphi * len + m_ddphi * len * len / 2.0);
+            m_dphi = wrap(m_dphi + m_ddphi * len);
+            n -= (std::size_t) len;
+        }
+    }
+
+private:
+    /** Wrap angle into [-pi, pi) */
+    static double wrap(double phase)
+    {
+        return phase - 2.0 * M_PI * std::floor((phase + M_PI) / (2.0 * M_PI));
+    }
+
+    double m_phase; //!< phase of next sample in radians
+    double m_dphi;  //!< phase increment per sample in radians
+    double m_ddphi; //!< increment of the phase increment per sample in radians
+};
+
+#endif /* INCLUDE_NCO_H_ */
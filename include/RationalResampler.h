@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_RATIONALRESAMPLER_H_
+#define INCLUDE_RATIONALRESAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "SDRDaemon.h"
+
+#define RATIONAL_RESAMPLER_MAX_PHASES     1024 // largest interpolation factor L after reduction of the ratio
+#define RATIONAL_RESAMPLER_MAX_RATIO      64   // largest ratio M/L of the input rate over the output rate
+#define RATIONAL_RESAMPLER_ZERO_CROSSINGS 16   // zero crossings of the prototype filter on each side of its center
+#define RATIONAL_RESAMPLER_PASSBAND       0.9  // cutoff relative to the lowest of the input and output Nyquist frequencies
+
+/**
+ * Polyphase resampler by the rational factor L/M of the output rate over the input rate.
+ *
+ * The prototype low pass filter is a Blackman windowed sinc designed at L times the
+ * input rate. It is split in L phases of nbTaps taps each stored in reverse order so
+ * that every output sample is the dot product of one phase with the last nbTaps input
+ * samples. Only the output samples are computed: the cost per output sample is nbTaps
+ * multiply accumulate per component whatever L and M. Arithmetic is done in floating
+ * point on separate I and Q arrays which the compiler vectorizes.
+ */
+class RationalResampler
+{
+public:
+    RationalResampler();
+
+    /**
+     * Set input and output rates in S/s and design the filter for the reduced ratio.
+     * The output rate cannot exceed the input rate nor be lower than the input rate
+     * divided by RATIONAL_RESAMPLER_MAX_RATIO as the number of taps grows with M/L.
+     * Return false and disable the resampler if the rates are not supported. The
+     * filter history is cleared.
+     */
+    bool setRates(uint32_t inputRate, uint32_t outputRate);
+
+    uint32_t getInputRate() const { return m_inputRate; }
+    uint32_t getOutputRate() const { return m_outputRate; }
+    unsigned int getInterpolation() const { return m_interp; }
+    unsigned int getDecimation() const { return m_decim; }
+    unsigned int getNbTaps() const { return m_nbTaps; }
+
+    /** Resample in to out. out is resized to the number of samples produced. */
+    void process(const IQSampleVector& in, IQSampleVector& out);
+
+private:
+    uint32_t     m_inputRate;
+    uint32_t     m_outputRate;
+    unsigned int m_interp;   //!< L
+    unsigned int m_decim;    //!< M
+    unsigned int m_nbTaps;   //!< taps per phase
+    unsigned int m_phase;    //!< phase of the next output sample
+    std::size_t  m_index;    //!< index of the last input sample of the next output sample in the work arrays
+    std::vector<float> m_taps; //!< L phases of nbTaps taps in reverse order
+    std::vector<float> m_re;   //!< history of nbTaps - 1 samples followed by the input block
+    std::vector<float> m_im;
+};
+
+#endif /* INCLUDE_RATIONALRESAMPLER_H_ */
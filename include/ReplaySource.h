@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SDRDAEMON_REPLAYSOURCE_H
+#define SDRDAEMON_REPLAYSOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "DeviceSource.h"
+
+/**
+ * Play back a recorded I/Q file as if it came from a device. The file is memory
+ * mapped and its samples are converted to blocks pushed to the source buffer at
+ * the sample rate (real time), at a multiple of it, or as fast as the daemon can
+ * take them. This gives reproducible input for the whole Rx pipeline without
+ * any hardware.
+ *
+ * Supported files:
+ *   - raw captures with no header: unsigned 8 bit (rtl_sdr), signed 8 bit
+ *     (hackrf_transfer) or signed 16 bit little endian I/Q. Format, sample bits,
+ *     sample rate and frequency are given by the configuration.
+ *   - .sdriq files as written by the sdrdaemontx file sink: sample rate and
+ *     frequency header followed by 16 bit I/Q.
+ *   - files starting with the Header below which gives all the parameters.
+ */
+class ReplaySource : public DeviceSource
+{
+public:
+    static const int default_block_length = 65536;
+
+    typedef enum
+    {
+        FormatU8 = 0, //!< unsigned 8 bit offset binary I/Q (RTL-SDR)
+        FormatS8,     //!< signed 8 bit I/Q (HackRF)
+        FormatS16,    //!< signed 16 bit little endian I/Q
+        FormatSDRIQ   //!< sdrdaemontx file sink format
+    } Format;
+
+#pragma pack(push, 1)
+    /** Optional header of a replay file */
+    struct Header
+    {
+        char     m_magic[6];        //!< "SDMNIQ"
+        uint8_t  m_format;          //!< Format (FormatU8, FormatS8 or FormatS16)
+        uint8_t  m_sampleBits;      //!< number of effective bits per sample
+        uint32_t m_sampleRate;      //!< sample rate in Hz
+        uint64_t m_centerFrequency; //!< center frequency in Hz
+        uint32_t m_reserved;
+    };
+#pragma pack(pop)
+
+    /** Open replay device. The file is given by the configuration. */
+    ReplaySource(int dev_index);
+
+    /** Close replay device. */
+    virtual ~ReplaySource();
+
+    /** Return sample size in bits */
+    virtual std::uint32_t get_sample_bits() { return m_sampleBits; }
+
+    /** 8 bit formats are normalized by the conversion kernel */
+    virtual bool can_normalize() const { return m_sampleBytes == 1; }
+
+    /** Return current sample frequency in Hz. */
+    virtual std::uint32_t get_sample_rate();
+
+    /** Return device current center frequency in Hz. */
+    virtual std::uint32_t get_frequency();
+
+    /** Print current parameters specific to device type */
+    virtual void print_specific_parms();
+
+    virtual bool start(DataBuffer<IQSample>* samples, std::atomic_bool *stop_flag);
+    virtual bool stop();
+
+    /** Return true if the device is OK, return false if there is an error. */
+    virtual operator bool() const
+    {
+        return m_error.empty();
+    }
+
+    /** Return a list of supported devices. */
+    static void get_device_names(std::vector<std::string>& devices);
+
+private:
+    /** Configure replay from a list of key=values */
+    virtual bool configure(parsekv::pairs_type& m);
+
+    /** Map file and read its header if any. Return false and set m_error on failure. */
+    bool openFile(const std::string& filename, Format format);
+    void closeFile();
+
+    /** Convert next block of samples from the file with the normalization shift. Return false at end of file. */
+    bool get_samples(IQSampleVector& samples, unsigned int normShift);
+
+    static void run(ReplaySource *source);
+
+    int                m_dev;
+    std::string        m_filename;
+    Format             m_format;
+    const uint8_t     *m_map;           //!< mapped file
+    std::size_t        m_mapSize;
+    const uint8_t     *m_data;          //!< first sample in the mapped file
+    std::size_t        m_nbSamples;     //!< number of samples in the file
+    std::size_t        m_sampleIndex;   //!< next sample to read
+    unsigned int       m_sampleBytes;   //!< bytes per I or Q
+    uint32_t           m_sampleBits;
+    uint32_t           m_srate;
+    uint64_t           m_freq;
+    float              m_speed;         //!< pacing: 1 real time, 0 as fast as possible
+    bool               m_loop;          //!< restart at beginning of file when the end is reached
+    bool               m_headerParams;  //!< sample rate and frequency were read from the file
+    int                m_block_length;  //!< number of samples
+    std::thread       *m_thread;
+};
+
+#endif // SDRDAEMON_REPLAYSOURCE_H
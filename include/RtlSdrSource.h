@@ -23,6 +23,8 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <mutex>
 
 #include "DeviceSource.h"
 
@@ -39,6 +41,9 @@ public:
     /** Return sample size in bits */
     virtual std::uint32_t get_sample_bits() { return 8; }
 
+    /** Samples are normalized by the conversion kernel */
+    virtual bool can_normalize() const { return true; }
+
     /** Return current sample frequency in Hz. */
     virtual std::uint32_t get_sample_rate();
 
@@ -89,6 +94,12 @@ private:
     /** Return current tuner gain in units of 0.1 dB. */
     int get_tuner_gain();
 
+    /** Return number of samples of a USB transfer for the current sample rate and latency target */
+    std::uint32_t get_transfer_samples();
+
+    /** Return number of USB transfers in flight for transfers of transferSamples samples */
+    std::uint32_t get_nb_transfers(std::uint32_t transferSamples);
+
     /**
      * Fetch a bunch of samples from the device.
      *
@@ -97,15 +108,20 @@ private:
      */
     static bool get_samples(IQSampleVector *samples);
     static void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx);
-    static void run();
-    static void readerThreadEntryPoint();
+    static void run(RtlSdrSource *source);
+    static void readerThreadEntryPoint(RtlSdrSource *source);
 
     struct rtlsdr_dev * m_dev;
     std::vector<int>    m_gains;
     std::string         m_gainsStr;
     bool                m_confAgc;
     std::thread         *m_thread;
-    static RtlSdrSource *m_this;
+    std::atomic<std::uint32_t> m_transferSamples; //!< samples per USB transfer of the current reading
+    std::atomic<std::uint32_t> m_nbTransfers;     //!< USB transfers of the current reading
+    std::mutex          m_asyncMutex;             //!< guards the reading state below and the cancellation of reading
+    bool                m_restartAsync;           //!< reading was cancelled to apply a new transfer size
+    bool                m_stopAsync;              //!< reading must not be started again
+    bool                m_readingAsync;           //!< reader thread is reading or about to read
 };
 
 #endif
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_SPSCRING_H_
+#define INCLUDE_SPSCRING_H_
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#define SPSCRING_CACHE_LINE 64
+
+/**
+ * Fixed capacity single producer single consumer ring.
+ *
+ * All slots are allocated at construction. Push and pull never take a lock
+ * and never allocate: elements are swapped in and out so whatever the consumer
+ * leaves in a slot is handed back to the producer on its next push. The producer
+ * and consumer indexes live on separate cache lines so that the two threads
+ * do not invalidate each other's line on every operation.
+ */
+template <class Element>
+class SPSCRing
+{
+public:
+    /** Construct ring. Capacity is rounded up to the next power of two. */
+    explicit SPSCRing(std::size_t capacity) :
+        m_head(0),
+        m_tail(0)
+    {
+        std::size_t size = 1;
+
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    /** Return number of slots */
+    std::size_t capacity() const { return m_slots.size(); }
+
+    /** Return number of occupied slots. Exact only from producer or consumer thread. */
+    std::size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * Producer side. Swap element with the next free slot.
+     * Return false without touching the element if the ring is full.
+     */
+    bool push(Element& element)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head - m_tail.load(std::memory_order_acquire) == m_slots.size()) {
+            return false;
+        }
+
+        std::swap(element, m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. Swap the oldest element with the given one.
+     * Return false if the ring is empty.
+     */
+    bool pull(Element& element)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        std::swap(element, m_slots[tail & m_mask]);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    char                     m_pad0[SPSCRING_CACHE_LINE];
+    std::atomic<std::size_t> m_head; //!< next slot to write (producer)
+    char                     m_pad1[SPSCRING_CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> m_tail; //!< next slot to read (consumer)
+    char                     m_pad2[SPSCRING_CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+    std::size_t              m_mask;
+    std::vector<Element>     m_slots;
+};
+
+#endif /* INCLUDE_SPSCRING_H_ */
@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_SAMPLECONVERTER_H_
+#define INCLUDE_SAMPLECONVERTER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAMPLECONVERTER_NEON
+#endif
+
+#include "SDRDaemon.h"
+#include "CpuFeatures.h"
+
+/**
+ * Conversion of the 8 bit I/Q samples of the devices to 16 bit I/Q samples.
+ *
+ * The kernel is selected on first use from the instruction sets of the CPU:
+ * AVX2 or SSE2 on x86, NEON on ARM when built with NEON support, else a plain
+ * loop. All kernels give the same result as the plain loop. Samples are written
+ * at the given place so that the caller can convert directly into a block taken
+ * from its buffer pool.
+ *
+ * Samples can be normalized to 16 bits in the same pass by giving the left shift
+ * Decimators::decimate1 would apply (16 - sample bits, from 0 to 15).
+ */
+class SampleConverter
+{
+public:
+    /** Convert unsigned 8 bit offset binary I/Q samples (RTL-SDR) */
+    static void convertU8(const uint8_t *in, IQSample *out, std::size_t nbSamples, unsigned int normShift = 0)
+    {
+        kernel()(in, (int16_t *) out, 2*nbSamples, 0x80, normShift);
+    }
+
+    /** Convert signed 8 bit I/Q samples (HackRF) */
+    static void convertS8(const int8_t *in, IQSample *out, std::size_t nbSamples, unsigned int normShift = 0)
+    {
+        kernel()((const uint8_t *) in, (int16_t *) out, 2*nbSamples, 0, normShift);
+    }
+
+    /** Return name of the kernel in use */
+    static const char *kernelName()
+    {
+        kernel();
+        return name();
+    }
+
+private:
+    /**
+     * Sign extend the bytes of in xored with offset and shift them left by shift.
+     * Offset 0x80 makes offset binary signed.
+     */
+    typedef void (*Kernel)(const uint8_t *in, int16_t *out, std::size_t len, uint8_t offset, unsigned int shift);
+
+    static Kernel kernel()
+    {
+        static const Kernel selected = select();
+        return selected;
+    }
+
+    static const char *&name()
+    {
+        static const char *kernelName = "scalar";
+        return kernelName;
+    }
+
+    static Kernel select()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (CpuFeatures::hasAVX2())
+        {
+            name() = "avx2";
+            return convertAVX2;
+        }
+
+        if (CpuFeatures::hasSSE2())
+        {
+            name() = "sse2";
+            return convertSSE2;
+        }
+#elif defined(SAMPLECONVERTER_NEON)
+        if (CpuFeatures::hasNEON())
+        {
+            name() = "neon";
+            return convertNEON;
+        }
+#endif
+        name() = "scalar";
+        return convertScalar;
+    }
+
+    static void convertScalar(const uint8_t *in, int16_t *out, std::size_t len, uint8_t offset, unsigned int shift)
+    {
+        int16_t scale = 1 << shift;
+
+        for (std::size_t i = 0; i < len; i++) {
+            out[i] = ((int8_t) (in[i] ^ offset)) * scale;
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("sse2")))
+    static void convertSSE2(const uint8_t *in, int16_t *out, std::size_t len, uint8_t offset, unsigned int shift)
+    {
+        const __m128i mask = _mm_set1_epi8((char) offset);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rightCount = _mm_cvtsi32_si128(shift < 8 ? 8 - shift : 0);
+        const __m128i leftCount = _mm_cvtsi32_si128(shift > 8 ? shift - 8 : 0);
+        std::size_t i = 0;
+
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[i]), mask);
+            // byte in the high half of each 16 bit word (shifted left by 8) then arithmetic
+            // shift right to sign extend when the shift is less than 8 or left when more
+            __m128i lo = _mm_sra_epi16(_mm_unpacklo_epi8(zero, x), rightCount);
+            __m128i hi = _mm_sra_epi16(_mm_unpackhi_epi8(zero, x), rightCount);
+            _mm_storeu_si128((__m128i *) &out[i],   _mm_sll_epi16(lo, leftCount));
+            _mm_storeu_si128((__m128i *) &out[i+8], _mm_sll_epi16(hi, leftCount));
+        }
+
+        convertScalar(&in[i], &out[i], len - i, offset, shift);
+    }
+
+    __attribute__((target("avx2")))
+    static void convertAVX2(const uint8_t *in, int16_t *out, std::size_t len, uint8_t offset, unsigned int shift)
+    {
+        const __m128i mask = _mm_set1_epi8((char) offset);
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        std::size_t i = 0;
+
+        for (; i + 32 <= len; i += 32)
+        {
+            __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[i]), mask);
+            __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[i+16]), mask);
+            _mm256_storeu_si256((__m256i *) &out[i],    _mm256_sll_epi16(_mm256_cvtepi8_epi16(x0), count));
+            _mm256_storeu_si256((__m256i *) &out[i+16], _mm256_sll_epi16(_mm256_cvtepi8_epi16(x1), count));
+        }
+
+        convertScalar(&in[i], &out[i], len - i, offset, shift);
+    }
+#endif
+
+#if defined(SAMPLECONVERTER_NEON)
+    static void convertNEON(const uint8_t *in, int16_t *out, std::size_t len, uint8_t offset, unsigned int shift)
+    {
+        const int8x16_t mask = vdupq_n_s8((int8_t) offset);
+        const int16x8_t count = vdupq_n_s16(shift);
+        std::size_t i = 0;
+
+        for (; i + 16 <= len; i += 16)
+        {
+            int8x16_t x = veorq_s8(vld1q_s8((const int8_t *) &in[i]), mask);
+            vst1q_s16(&out[i],   vshlq_s16(vmovl_s8(vget_low_s8(x)), count));
+            vst1q_s16(&out[i+8], vshlq_s16(vmovl_s8(vget_high_s8(x)), count));
+        }
+
+        convertScalar(&in[i], &out[i], len - i, offset, shift);
+    }
+#endif
+};
+
+#endif /* INCLUDE_SAMPLECONVERTER_H_ */
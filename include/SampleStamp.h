@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_SAMPLESTAMP_H_
+#define INCLUDE_SAMPLESTAMP_H_
+
+#include <time.h>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Acquisition time of the first sample of a block.
+ *
+ * Devices stamp each transfer as soon as they receive it. The first sample was
+ * acquired one transfer duration earlier so the block duration is subtracted
+ * from the clocks. The stamp then travels with the block through the buffers
+ * and the decimation so that the meta data of a frame gives the time its first
+ * sample was acquired instead of the time it was framed. The monotonic clock
+ * measures the latency of the pipeline and the realtime clock is sent to the
+ * clients.
+ */
+struct SampleStamp
+{
+    SampleStamp() :
+        m_sampleIndex(0),
+        m_normShift(0),
+        m_valid(false)
+    {
+        m_monotonic.tv_sec = 0;
+        m_monotonic.tv_nsec = 0;
+        m_realtime.tv_sec = 0;
+        m_realtime.tv_nsec = 0;
+    }
+
+    std::uint64_t   m_sampleIndex; //!< index of the first sample in the device stream
+    struct timespec m_monotonic;   //!< CLOCK_MONOTONIC at acquisition of the first sample
+    struct timespec m_realtime;    //!< CLOCK_REALTIME at acquisition of the first sample
+    unsigned int    m_normShift;   //!< left shift applied by the device conversion to normalize samples to 16 bits
+    bool            m_valid;       //!< false for blocks not stamped by a device
+
+    /** Stamp a block of nbSamples starting at sampleIndex just received at sampleRate */
+    static SampleStamp received(std::uint64_t sampleIndex, std::size_t nbSamples, std::uint32_t sampleRate)
+    {
+        SampleStamp stamp;
+        double duration = sampleRate > 0 ? (double) nbSamples / sampleRate : 0.0;
+
+        clock_gettime(CLOCK_MONOTONIC, &stamp.m_monotonic);
+        clock_gettime(CLOCK_REALTIME, &stamp.m_realtime);
+        stamp.m_monotonic = add(stamp.m_monotonic, -duration);
+        stamp.m_realtime = add(stamp.m_realtime, -duration);
+        stamp.m_sampleIndex = sampleIndex;
+        stamp.m_valid = true;
+
+        return stamp;
+    }
+
+    /** Return the stamp of the sample nbSamples later at sampleRate */
+    SampleStamp advance(std::uint64_t nbSamples, std::uint32_t sampleRate) const
+    {
+        SampleStamp stamp(*this);
+        double duration = sampleRate > 0 ? (double) nbSamples / sampleRate : 0.0;
+
+        stamp.m_monotonic = add(m_monotonic, duration);
+        stamp.m_realtime = add(m_realtime, duration);
+
+        return stamp;
+    }
+
+    /** Return the time elapsed since acquisition in seconds */
+    double age() const
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (now.tv_sec - m_monotonic.tv_sec) + (now.tv_nsec - m_monotonic.tv_nsec) * 1e-9;
+    }
+
+    static struct timespec add(const struct timespec& ts, double seconds)
+    {
+        struct timespec ret;
+        long long nsec = ts.tv_nsec + (long long) (seconds * 1e9);
+        ret.tv_sec = ts.tv_sec + nsec / 1000000000LL;
+        nsec %= 1000000000LL;
+
+        if (nsec < 0)
+        {
+            nsec += 1000000000LL;
+            ret.tv_sec--;
+        }
+
+        ret.tv_nsec = nsec;
+        return ret;
+    }
+};
+
+#endif /* INCLUDE_SAMPLESTAMP_H_ */
@@ -25,7 +25,14 @@
 #include <thread>
 
 #include "DeviceSource.h"
-
+#include "Nco.h"
+
+/**
+ * Test signal generator. The signal is the sum of one or more tones, an
+ * optional chirp sweeping the whole band and optional Gaussian noise. Blocks
+ * are pushed at the sample rate (real time) or as fast as the daemon takes
+ * them so that the pipeline can be stressed at rates no device reaches.
+ */
 class TestSource : public DeviceSource
 {
 public:
@@ -82,33 +89,50 @@ private:
     		       std::uint32_t sample_rate,
                    std::uint32_t frequency,
                    std::int32_t carrierOffset,
-				   float deltaPhase,
                    float tuner_gain,
                    int block_length=default_block_length);
 
+    /** Set the oscillators frequencies from the current parameters. Phases are kept. */
+    void setup_oscillators();
+
+    /** Fill the noise table with Gaussian samples of the current noise level */
+    void setup_noise();
+
     /**
      * Fetch a bunch of samples from the device.
      *
      * This function must be called regularly to maintain streaming.
      * Return true for success, false if an error occurred.
      */
-    static bool get_samples(IQSampleVector *samples);
+    static bool get_samples(TestSource *source, IQSampleVector *samples);
+
+    static void run(TestSource *source);
 
-    static void run();
-    static int read_samples(int16_t *data, int wantSize, int& getSize, float& phasor, int sampleRate, float deltaPhase, float amplitude);
+    /** Generate a block of samples */
+    void generate(IQSample *samples, unsigned int nbSamples);
 
-    float getDeltaPhase(int32_t deltaFrequency, uint32_t sample_rate) const { return 2.0 * M_PI * ((float) deltaFrequency / sample_rate); }
+    static const unsigned int max_tones = 16;
+    static const unsigned int noise_table_size = 1<<18; //!< number of floats, power of two
 
     int               m_dev;
     int               m_block_length; //!< number of samples
     std::thread       *m_thread;
-    static TestSource *m_this;
-    int32_t           m_carrierOffset;
-    float             m_phase;
-    float             m_deltaPhase;
+    int32_t           m_carrierOffset; //!< first tone offset from center frequency in Hz
     uint64_t          m_freq;
     uint32_t          m_srate;
     float             m_amplitude;
+    unsigned int      m_nbTones;
+    int32_t           m_toneStep;      //!< offset between successive tones in Hz
+    unsigned int      m_chirpPeriod;   //!< duration of a sweep across the band in ms. 0 for no chirp.
+    int               m_noiseDb;       //!< noise power relative to full scale in negative dB
+    bool              m_noise;
+    float             m_speed;         //!< pacing: 1 real time, 0 as fast as possible
+    std::vector<Nco>  m_tones;
+    Nco               m_chirp;
+    std::vector<float> m_re;           //!< generation buffer, in phase
+    std::vector<float> m_im;           //!< generation buffer, quadrature
+    std::vector<float> m_noiseTable;
+    uint32_t          m_noiseState;    //!< xorshift state drawing the noise table offsets
 
     static const uint32_t m_sampleBits;
     static const uint32_t m_sampleWidth;
@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_THREADCONFIG_H_
+#define INCLUDE_THREADCONFIG_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+
+/**
+ * Process wide CPU affinity, scheduling policy and name of the daemon threads.
+ *
+ * Each thread is identified by its role:
+ *   - main:    main processing loop (decimation or interpolation)
+ *   - decim:   Rx decimation workers when decimation is shared between threads
+ *   - device:  thread exchanging samples with the device (USB callbacks or blocking reads)
+ *   - control: device thread polling for configuration messages when separate from the above
+ *   - output:  Rx buffered UDP output (framing)
+ *   - input:   Tx buffered UDP input
+ *   - fec:     Rx FEC encoding
+ *   - send:    Rx UDP transmission
+ *
+ * Settings are parsed from the command line before any thread is started then
+ * each thread calls apply with its role when it starts running. Threads created
+ * by libraries (libusb transfers) call applyOnce from their callback instead.
+ */
+class ThreadConfig
+{
+public:
+    struct Settings
+    {
+        Settings() : m_policy(-1), m_priority(0) {}
+        std::vector<int> m_cpus; //!< CPUs the thread may run on. Empty for no change.
+        int m_policy;            //!< SCHED_OTHER, SCHED_FIFO or SCHED_RR. -1 for no change.
+        int m_priority;          //!< Real time priority for SCHED_FIFO and SCHED_RR
+    };
+
+    /**
+     * Parse a thread specification "role:cpus[:policy[:priority]]" where cpus is a
+     * comma separated list of CPU numbers or ranges (e.g. 0,2-3) possibly empty,
+     * and policy is one of other, fifo or rr. Return false and set error if invalid.
+     */
+    static bool parse(const std::string& spec, std::string& error)
+    {
+        std::vector<std::string> fields;
+        std::istringstream is(spec);
+        std::string field;
+
+        while (std::getline(is, field, ':')) {
+            fields.push_back(field);
+        }
+
+        if ((fields.size() < 2) || (fields.size() > 4))
+        {
+            error = "expecting role:cpus[:policy[:priority]]";
+            return false;
+        }
+
+        if (!isRole(fields[0]))
+        {
+            error = "unknown thread role " + fields[0];
+            return false;
+        }
+
+        Settings settings;
+        std::istringstream cpus(fields[1]);
+
+        while (std::getline(cpus, field, ','))
+        {
+            char *endp;
+            long first = strtol(field.c_str(), &endp, 10);
+            long last = first;
+
+            if (*endp == '-') {
+                last = strtol(endp + 1, &endp, 10);
+            }
+
+            if ((endp == field.c_str()) || (*endp != '\0') || (first < 0) || (last < first) || (last >= CPU_SETSIZE))
+            {
+                error = "invalid CPU list " + fields[1];
+                return false;
+            }
+
+            for (long cpu = first; cpu <= last; cpu++) {
+                settings.m_cpus.push_back(cpu);
+            }
+        }
+
+        if (fields.size() > 2)
+        {
+            if (fields[2] == "other") {
+                settings.m_policy = SCHED_OTHER;
+            } else if (fields[2] == "fifo") {
+                settings.m_policy = SCHED_FIFO;
+            } else if (fields[2] == "rr") {
+                settings.m_policy = SCHED_RR;
+            } else {
+                error = "invalid scheduling policy " + fields[2];
+                return false;
+            }
+        }
+
+        if (fields.size() > 3)
+        {
+            settings.m_priority = atoi(fields[3].c_str());
+            int pmin = sched_get_priority_min(settings.m_policy);
+            int pmax = sched_get_priority_max(settings.m_policy);
+
+            if ((settings.m_priority < pmin) || (settings.m_priority > pmax))
+            {
+                std::ostringstream os;
+                os << "priority out of range [" << pmin << "," << pmax << "]";
+                error = os.str();
+                return false;
+            }
+        }
+        else if ((settings.m_policy == SCHED_FIFO) || (settings.m_policy == SCHED_RR))
+        {
+            settings.m_priority = sched_get_priority_min(settings.m_policy);
+        }
+
+        registry()[fields[0]] = settings;
+        return true;
+    }
+
+    /**
+     * Name the calling thread after its role and apply the settings of the role if any.
+     * The main thread of the process is not renamed as its name is the one of the
+     * process shown by ps or used by pkill.
+     */
+    static void apply(const char *role)
+    {
+        if (syscall(SYS_gettid) != getpid())
+        {
+            std::string name = std::string("sdmn-") + role;
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        }
+
+        std::map<std::string, Settings>::const_iterator it = registry().find(role);
+
+        if (it == registry().end()) {
+            return;
+        }
+
+        const Settings& settings = it->second;
+        int rc;
+
+        if (!settings.m_cpus.empty())
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+
+            for (std::vector<int>::const_iterator cit = settings.m_cpus.begin(); cit != settings.m_cpus.end(); ++cit) {
+                CPU_SET(*cit, &cpuset);
+            }
+
+            if ((rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset)) != 0) {
+                std::cerr << "ThreadConfig::apply: " << role << ": cannot set CPU affinity: " << strerror(rc) << std::endl;
+            }
+        }
+
+        if (settings.m_policy >= 0)
+        {
+            struct sched_param param;
+            param.sched_priority = settings.m_priority;
+
+            if ((rc = pthread_setschedparam(pthread_self(), settings.m_policy, &param)) != 0) {
+                std::cerr << "ThreadConfig::apply: " << role << ": cannot set scheduling policy: " << strerror(rc) << std::endl;
+            }
+        }
+    }
+
+    /** Apply only the first time it is called from the calling thread */
+    static void applyOnce(const char *role)
+    {
+        static thread_local bool applied = false;
+
+        if (!applied)
+        {
+            apply(role);
+            applied = true;
+        }
+    }
+
+private:
+    static bool isRole(const std::string& role)
+    {
+        static const char *roles[] = {"main", "decim", "device", "control", "output", "input", "fec", "send"};
+
+        for (unsigned int i = 0; i < sizeof(roles)/sizeof(roles[0]); i++)
+        {
+            if (role == roles[i]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static std::map<std::string, Settings>& registry()
+    {
+        static std::map<std::string, Settings> settingsMap;
+        return settingsMap;
+    }
+};
+
+#endif /* INCLUDE_THREADCONFIG_H_ */
@@ -23,6 +23,7 @@
 #include <cstddef>
 
 #include "SDRDaemon.h"
+#include "SampleStamp.h"
 #include "UDPSocket.h"
 #include "CRC64.h"
 
@@ -101,6 +102,9 @@ public:
     virtual void setNbBlocksFEC(int nbBlocksFEC __attribute__((unused))) {};
     virtual void setTxDelay(int txDelay __attribute__((unused))) {};
 
+    /** Set the acquisition stamp of the next sample written */
+    virtual void setStamp(const SampleStamp& stamp __attribute__((unused))) {};
+
     /** Return true if the stream is OK, return false if there is an error. */
     operator bool() const
     {
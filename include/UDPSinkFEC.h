@@ -51,12 +51,14 @@
 #include <atomic>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <condition_variable>
 #include "cm256.h"
 #include "UDPSink.h"
 
 #define UDPSINKFEC_UDPSIZE 512
 #define UDPSINKFEC_NBORIGINALBLOCKS 128
-#define UDPSINKFEC_NBTXBLOCKS 8
+#define UDPSINKFEC_NBTXBLOCKS 8 //!< default number of frames queued for transmission
 
 namespace std
 {
@@ -66,13 +68,69 @@ namespace std
 class UDPSinkFEC : public UDPSink
 {
 public:
-    UDPSinkFEC(const std::string& address, unsigned int port);
+    /**
+     * Constructor.
+     *
+     * Framing is done in write on the caller thread. Complete frames then go
+     * through a FEC encoding thread and a sending thread. The three stages
+     * share a ring of frame rows.
+     *
+     * nbTxBlocks :: number of complete frames that can be queued between the
+     *               framing in write and the sending thread
+     */
+    UDPSinkFEC(const std::string& address, unsigned int port, unsigned int nbTxBlocks = UDPSINKFEC_NBTXBLOCKS);
     virtual ~UDPSinkFEC();
     virtual void write(const IQSampleVector& samples_in);
+
+    /**
+     * Zero copy framing. Return the room left in the payload of the UDP block
+     * being built in the Tx ring so that samples can be produced directly at
+     * their place for the wire. nbSamples is set to the number of samples that
+     * can be written at the returned address. Meta data (center frequency,
+     * sample rate and size) must be set before the first call of a frame.
+     */
+    IQSample *getWriteSpan(unsigned int& nbSamples);
+
+    /**
+     * Account for nbSamples written at the address returned by getWriteSpan.
+     * The block is completed when its payload is full and the frame is handed
+     * to the FEC encoding thread when its last block is complete. This may wait
+     * for the sending thread to free a row of the Tx ring.
+     */
+    void commitWriteSpan(unsigned int nbSamples);
+
     virtual void setNbBlocksFEC(int nbBlocksFEC);
     virtual void setTxDelay(int txDelay);
+
+    /**
+     * Set the acquisition stamp of the next sample written. The meta data of
+     * each frame then carries the acquisition time of its first sample derived
+     * from the last stamp and the number of samples framed since at the current
+     * sample rate. Without stamps the time of framing is used.
+     */
+    virtual void setStamp(const SampleStamp& stamp);
     void reset();
 
+    /** Return number of samples framed since start */
+    uint64_t getSamplesFramed() const { return m_samplesFramed.load(); }
+    /** Return number of UDP blocks sent since start */
+    uint64_t getBlocksSent() const { return m_blocksSent.load(); }
+
+    /** Return time in microseconds from acquisition to framing of the first sample of the last frame */
+    int64_t getFrameLatency() const { return m_frameLatency.load(); }
+    /** Return number of frames FEC encoded since start */
+    uint64_t getFramesEncoded()
+    {
+        std::unique_lock<std::mutex> lock(m_txMutex);
+        return m_txFramesEncoded;
+    }
+    /** Return number of complete frames waiting for FEC encoding or sending */
+    unsigned int getFramesPending()
+    {
+        std::unique_lock<std::mutex> lock(m_txMutex);
+        return m_txFramesQueued - m_txFramesSent;
+    }
+
 private:
 #pragma pack(push, 1)
     struct MetaDataFEC
@@ -83,8 +141,8 @@ private:
         uint8_t  m_sampleBits;        //!< 10 number of effective bits per sample
         uint8_t  m_nbOriginalBlocks;  //!< 11 number of blocks with original (protected) data
         uint8_t  m_nbFECBlocks;       //!< 12 number of blocks carrying FEC
-        uint32_t m_tv_sec;            //!< 16 seconds of timestamp at start time of super-frame processing
-        uint32_t m_tv_usec;           //!< 20 microseconds of timestamp at start time of super-frame processing
+        uint32_t m_tv_sec;            //!< 16 seconds of acquisition time of the first sample of the super-frame
+        uint32_t m_tv_usec;           //!< 20 microseconds of acquisition time of the first sample of the super-frame
         uint32_t m_crc32;             //!< 24 CRC32 of the above
 
         bool operator==(const MetaDataFEC& rhs)
@@ -126,18 +184,20 @@ private:
         uint16_t m_frameIndex;
         int m_nbBlocksFEC;
         int m_txDelay;
+        int m_nbBlocksTx;   //!< number of blocks to send after FEC encoding
     };
 
     CM256 m_cm256;                       //!< CM256 library object
     MetaDataFEC m_currentMetaFEC;        //!< Meta data for current frame
     std::atomic_int m_nbBlocksFEC;       //!< Variable number of FEC blocks
     std::atomic_int m_txDelay;           //!< Delay in microseconds (usleep) between each sending of an UDP datagram
-    SuperBlock m_txBlocks[UDPSINKFEC_NBTXBLOCKS][256]; //!< UDP blocks to send with original data + FEC
+    unsigned int m_nbTxBlocks;           //!< Number of frame rows in the Tx ring
+    std::vector<SuperBlock> m_txBlocks;  //!< UDP blocks to send with original data + FEC. 256 per row.
     std::thread *m_txThread;             //!< Thread to transmit UDP blocks
-    SuperBlock m_superBlock;             //!< current super block being built
+    std::thread *m_fecThread;            //!< Thread to compute FEC blocks
     //ProtectedBlock m_fecBlocks[256];     //!< FEC data
     int m_txBlockIndex;                  //!< Current index in blocks to transmit in the Tx row
-    int m_txBlocksIndex;                 //!< Current index of Tx blocks row
+    int m_txBlocksIndex;                 //!< Current index of Tx blocks row: m_txFramesQueued % m_nbTxBlocks
     uint16_t m_frameCount;               //!< transmission frame count
     int m_sampleIndex;                   //!< Current sample index in protected block data
     //cm256_encoder_params m_cm256Params;  //!< Main interface with CM256 encoder
@@ -145,10 +205,24 @@ private:
     bool m_cm256Valid;
     std::atomic_bool m_udpSent;          //!< True when UDP sending thread has finished (Frame transmission complete)
     std::atomic_bool m_running;
-    TxControlBlock m_txControlBlocks[UDPSINKFEC_NBTXBLOCKS];
-    std::atomic_int m_txIndexCurrent;
-    std::atomic_int m_txIndexProcessing;
-
+    std::atomic<uint64_t> m_samplesFramed;
+    std::atomic<uint64_t> m_blocksSent;
+    SampleStamp m_stamp;                 //!< acquisition stamp of the last stamped sample
+    uint64_t m_stampSamplesFramed;       //!< samples framed when the last stamp was set
+    std::atomic<int64_t> m_frameLatency; //!< acquisition to framing in microseconds. -1 if unknown.
+    std::vector<TxControlBlock> m_txControlBlocks;
+    uint64_t m_txFramesQueued;           //!< Frames handed to the FEC thread since start (under m_txMutex)
+    uint64_t m_txFramesEncoded;          //!< Frames FEC encoded since start (under m_txMutex)
+    uint64_t m_txFramesSent;             //!< Frames sent since start (under m_txMutex)
+    std::mutex m_txMutex;
+    std::condition_variable m_txFrameReady;   //!< signals the FEC thread a frame is queued or stop
+    std::condition_variable m_txFrameEncoded; //!< signals the sending thread a frame is encoded or stop
+    std::condition_variable m_txFrameFree;    //!< signals write that a row has been sent
+
+    SuperBlock *txRow(int row) { return &m_txBlocks[row * 256]; }
+    void writeMetaData();
+
+    static void encodeFEC(UDPSinkFEC *udpSinkFEC);
     static void transmitUDP(UDPSinkFEC *udpSinkFEC);
 };
 
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDE_WORKERPOOL_H_
+#define INCLUDE_WORKERPOOL_H_
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "ThreadConfig.h"
+
+/**
+ * Threads shared by the processing of all devices of the process.
+ *
+ * A batch of count tasks is run by calling run with a function taking the task
+ * index. The calling thread runs task 0 then helps with the remaining tasks of
+ * its own batch so that a batch always completes even when all the threads of
+ * the pool are busy with the batches of other devices. Batches are taken by the
+ * pool threads in the order they were queued.
+ */
+class WorkerPool
+{
+public:
+    /** Maximum number of threads in the pool */
+    static const unsigned int max_threads = 64;
+
+    WorkerPool() :
+        m_stop(false)
+    {
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_workStart.notify_all();
+
+        for (std::vector<std::thread*>::iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+        {
+            (*it)->join();
+            delete *it;
+        }
+    }
+
+    /** Make sure the pool has at least nbThreads threads. Threads are never removed. */
+    void reserve(unsigned int nbThreads)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        nbThreads = std::min(nbThreads, max_threads);
+
+        while (m_threads.size() < nbThreads) {
+            m_threads.push_back(new std::thread(runWorker, this));
+        }
+    }
+
+    /** Return number of threads of the pool */
+    unsigned int size()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_threads.size();
+    }
+
+    /** Run task(i) for i in [0, count) and return when all are done */
+    void run(unsigned int count, const std::function<void(unsigned int)>& task)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        Batch batch(&task, count);
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (count > 1)
+        {
+            m_batches.push_back(&batch);
+            m_workStart.notify_all();
+        }
+
+        while (true)
+        {
+            if (batch.m_next < batch.m_count)
+            {
+                unsigned int index = take(&batch);
+                lock.unlock();
+                task(index);
+                lock.lock();
+                batch.m_pending--;
+            }
+            else if (batch.m_pending == 0)
+            {
+                break;
+            }
+            else
+            {
+                m_workDone.wait(lock);
+            }
+        }
+    }
+
+private:
+    struct Batch
+    {
+        Batch(const std::function<void(unsigned int)> *task, unsigned int count) :
+            m_task(task),
+            m_count(count),
+            m_next(0),
+            m_pending(count)
+        {}
+
+        const std::function<void(unsigned int)> *m_task;
+        unsigned int m_count;   //!< number of tasks
+        unsigned int m_next;    //!< next task to start
+        unsigned int m_pending; //!< tasks not done yet
+    };
+
+    std::vector<std::thread*> m_threads;
+    std::deque<Batch*>        m_batches; //!< batches with tasks not started yet
+    std::mutex                m_mutex;
+    std::condition_variable   m_workStart;
+    std::condition_variable   m_workDone;
+    bool                      m_stop;
+
+    /** Take next task of batch and unqueue the batch when it was the last one. Called with the lock held. */
+    unsigned int take(Batch *batch)
+    {
+        unsigned int index = batch->m_next++;
+
+        if (batch->m_next == batch->m_count)
+        {
+            std::deque<Batch*>::iterator it = std::find(m_batches.begin(), m_batches.end(), batch);
+
+            if (it != m_batches.end()) {
+                m_batches.erase(it);
+            }
+        }
+
+        return index;
+    }
+
+    static void runWorker(WorkerPool *pool)
+    {
+        ThreadConfig::apply("decim");
+        std::unique_lock<std::mutex> lock(pool->m_mutex);
+
+        while (true)
+        {
+            while (!pool->m_stop && pool->m_batches.empty()) {
+                pool->m_workStart.wait(lock);
+            }
+
+            if (pool->m_stop) {
+                break;
+            }
+
+            Batch *batch = pool->m_batches.front();
+            unsigned int index = pool->take(batch);
+            lock.unlock();
+            (*batch->m_task)(index);
+            lock.lock();
+
+            if (--batch->m_pending == 0) {
+                pool->m_workDone.notify_all();
+            }
+        }
+    }
+};
+
+#endif /* INCLUDE_WORKERPOOL_H_ */
@@ -26,9 +26,12 @@
 
 #include "AirspySource.h"
 #include "util.h"
+#include "ThreadConfig.h"
 #include "parsekv.h"
 
-AirspySource *AirspySource::m_this = 0;
+std::mutex AirspySource::m_libraryMutex;
+int AirspySource::m_libraryUsers = 0;
+
 const std::vector<int> AirspySource::m_lgains({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14});
 const std::vector<int> AirspySource::m_mgains({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
 const std::vector<int> AirspySource::m_vgains({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
@@ -46,9 +49,10 @@ AirspySource::AirspySource(int dev_index) :
     m_lnaAGC(false),
     m_mixAGC(false),
     m_running(false),
-    m_thread(0)
+    m_thread(0),
+    m_libraryInit(false)
 {
-    airspy_error rc = (airspy_error) airspy_init();
+    airspy_error rc = library_init();
 
     if (rc != AIRSPY_SUCCESS)
     {
@@ -59,21 +63,27 @@ AirspySource::AirspySource(int dev_index) :
     }
     else
     {
-        for (int i = 0; i < AIRSPY_MAX_DEVICE; i++)
+        m_libraryInit = true;
+
+        // Open by serial number as airspy_open opens the first device not yet opened
+        uint64_t serials[AIRSPY_MAX_DEVICE];
+        int count = airspy_list_devices(serials, AIRSPY_MAX_DEVICE);
+
+        if ((dev_index < 0) || (dev_index >= count))
         {
-            rc = (airspy_error) airspy_open(&m_dev);
+            std::ostringstream err_ostr;
+            err_ostr << "Failed to open Airspy device " << dev_index << ": " << (count < 0 ? 0 : count) << " devices found";
+            m_error = err_ostr.str();
+            m_dev = 0;
+        }
+        else
+        {
+            rc = (airspy_error) airspy_open_sn(&m_dev, serials[dev_index]);
 
-            if (rc == AIRSPY_SUCCESS)
-            {
-                if (i == dev_index)
-                {
-                    break;
-                }
-            }
-            else
+            if (rc != AIRSPY_SUCCESS)
             {
                 std::ostringstream err_ostr;
-                err_ostr << "Failed to open Airspy device at sequence " << i;
+                err_ostr << "Failed to open Airspy device " << dev_index << " (" << rc << ": " << airspy_error_name(rc) << ")";
                 m_error = err_ostr.str();
                 m_dev = 0;
             }
@@ -149,8 +159,6 @@ AirspySource::AirspySource(int dev_index) :
 
     std::ostringstream bwfilt_ostr;
     bwfilt_ostr << std::fixed << std::setprecision(2);
-
-    m_this = this;
 }
 
 AirspySource::~AirspySource()
@@ -159,22 +167,48 @@ AirspySource::~AirspySource()
         airspy_close(m_dev);
     }
 
-    airspy_error rc = (airspy_error) airspy_exit();
-    std::cerr << "AirspySource::~AirspySource: Airspy library exit: " << rc << ": " << airspy_error_name(rc) << std::endl;
+    if (m_libraryInit)
+    {
+        airspy_error rc = library_exit();
+        std::cerr << "AirspySource::~AirspySource: Airspy library exit: " << rc << ": " << airspy_error_name(rc) << std::endl;
+    }
+}
+
+airspy_error AirspySource::library_init()
+{
+    std::unique_lock<std::mutex> lock(m_libraryMutex);
+
+    if (m_libraryUsers == 0)
+    {
+        airspy_error rc = (airspy_error) airspy_init();
+
+        if (rc != AIRSPY_SUCCESS) {
+            return rc;
+        }
+    }
+
+    m_libraryUsers++;
+    return AIRSPY_SUCCESS;
+}
+
+airspy_error AirspySource::library_exit()
+{
+    std::unique_lock<std::mutex> lock(m_libraryMutex);
+
+    if (--m_libraryUsers > 0) {
+        return AIRSPY_SUCCESS; // still used
+    }
 
-    m_this = 0;
+    return (airspy_error) airspy_exit();
 }
 
 void AirspySource::get_device_names(std::vector<std::string>& devices)
 {
-    airspy_device *airspy_ptr;
-    airspy_read_partid_serialno_t read_partid_serialno;
-    uint32_t serial_msb = 0;
-    uint32_t serial_lsb = 0;
+    uint64_t serials[AIRSPY_MAX_DEVICE];
     airspy_error rc;
-    int i;
+    int count;
 
-    rc = (airspy_error) airspy_init();
+    rc = library_init();
 
     if (rc != AIRSPY_SUCCESS)
     {
@@ -182,40 +216,18 @@ void AirspySource::get_device_names(std::vector<std::string>& devices)
         return;
     }
 
-    for (i=0; i < AIRSPY_MAX_DEVICE; i++)
-    {
-        rc = (airspy_error) airspy_open(&airspy_ptr);
-        std::cerr << "AirspySource::get_device_names: try to get device " << i << " serial number" << std::endl;
-
-        if (rc == AIRSPY_SUCCESS)
-        {
-            std::cerr << "AirspySource::get_device_names: device " << i << " open OK" << std::endl;
-
-            rc = (airspy_error) airspy_board_partid_serialno_read(airspy_ptr, &read_partid_serialno);
-
-            if (rc == AIRSPY_SUCCESS)
-            {
-                serial_msb = read_partid_serialno.serial_no[2];
-                serial_lsb = read_partid_serialno.serial_no[3];
-                std::ostringstream devname_ostr;
-                devname_ostr << "Serial " << std::hex << std::setw(8) << std::setfill('0') << serial_msb << serial_lsb;
-                devices.push_back(devname_ostr.str());
-            }
-            else
-            {
-                std::cerr << "AirspySource::get_device_names: failed to get device " << i << " serial number: " << rc << ": " << airspy_error_name(rc) << std::endl;
-            }
+    devices.clear();
+    count = airspy_list_devices(serials, AIRSPY_MAX_DEVICE);
+    std::cerr << "AirspySource::get_device_names: enumerated " << (count < 0 ? 0 : count) << " Airspy devices" << std::endl;
 
-            airspy_close(airspy_ptr);
-        }
-        else
-        {
-            std::cerr << "AirspySource::get_device_names: enumerated " << i << " Airspy devices: " << airspy_error_name(rc) << std::endl;
-            break; // finished
-        }
+    for (int i = 0; i < count; i++)
+    {
+        std::ostringstream devname_ostr;
+        devname_ostr << "Serial " << std::hex << std::setw(16) << std::setfill('0') << serials[i];
+        devices.push_back(devname_ostr.str());
     }
 
-    rc = (airspy_error) airspy_exit();
+    rc = library_exit();
     std::cerr << "AirspySource::get_device_names: Airspy library exit: " << rc << ": " << airspy_error_name(rc) << std::endl;
 }
 
@@ -664,7 +676,7 @@ bool AirspySource::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
     {
         std::cerr << "AirspySource::start: starting" << std::endl;
         m_running = true;
-        m_thread = new std::thread(run, m_dev, stop_flag);
+        m_thread = new std::thread(run, this);
         sleep(1);
         return *this;
     }
@@ -676,12 +688,15 @@ bool AirspySource::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
     }
 }
 
-void AirspySource::run(airspy_device* dev, std::atomic_bool *stop_flag)
+void AirspySource::run(AirspySource *source)
 {
+    airspy_device *dev = source->m_dev;
+    std::atomic_bool *stop_flag = source->m_stop_flag;
     std::cerr << "AirspySource::run" << std::endl;
+    ThreadConfig::apply("control");
     void *msgBuf = 0;
 
-    airspy_error rc = (airspy_error) airspy_start_rx(dev, rx_callback, 0);
+    airspy_error rc = (airspy_error) airspy_start_rx(dev, rx_callback, (void *) source);
 
     if (rc == AIRSPY_SUCCESS)
     {
@@ -689,13 +704,13 @@ void AirspySource::run(airspy_device* dev, std::atomic_bool *stop_flag)
         {
             sleep(1);
 
-            int len = nn_recv(m_this->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+            int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
 
             if ((len > 0) && msgBuf)
             {
                 std::string msg((char *) msgBuf, len);
                 std::cerr << "AirspySource::run: received: " << msg << std::endl;
-                m_this->DeviceSource::configure(msg);
+                source->DeviceSource::configure(msg);
                 nn_freemsg(msgBuf);
                 msgBuf = 0;
             }
@@ -727,9 +742,11 @@ int AirspySource::rx_callback(airspy_transfer_t* transfer)
 {
     int len = transfer->sample_count * 2; // interleaved I/Q samples
 
-    if (m_this)
+    AirspySource *source = (AirspySource *) transfer->ctx;
+
+    if (source)
     {
-        m_this->callback((short *) transfer->samples, len);
+        source->callback((short *) transfer->samples, len);
     }
 
     return 0;
@@ -737,9 +754,9 @@ int AirspySource::rx_callback(airspy_transfer_t* transfer)
 
 void AirspySource::callback(const short* buf, int len)
 {
-    IQSampleVector iqsamples;
-
-    iqsamples.resize(len/2);
+    ThreadConfig::applyOnce("device");
+    SampleStamp stamp = stamp_block(len/2);
+    IQSampleVector iqsamples = m_buf->get_block(len/2);
 
     for (int i = 0, j = 0; i < len; i+=2, j++)
     {
@@ -748,5 +765,5 @@ void AirspySource::callback(const short* buf, int len)
         iqsamples[j] = IQSample(re, im);
     }
 
-    m_buf->push(move(iqsamples));
+    m_buf->push(move(iqsamples), stamp);
 }
@@ -16,6 +16,7 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.          //
 ///////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 #include <iostream>
@@ -25,9 +26,9 @@
 
 #include "BladeRFSource.h"
 #include "util.h"
+#include "ThreadConfig.h"
 #include "parsekv.h"
 
-BladeRFSource *BladeRFSource::m_this = 0;
 const std::vector<int> BladeRFSource::m_lnaGains({0, 3, 6});
 const std::vector<int> BladeRFSource::m_vga1Gains({5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30});
 const std::vector<int> BladeRFSource::m_vga2Gains({0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30});
@@ -45,6 +46,12 @@ BladeRFSource::BladeRFSource(const char *serial) :
     m_lnaGain(3),
     m_vga1Gain(6),
     m_vga2Gain(5),
+    m_blockSize(default_block_size),
+    m_nbBuffers(default_nb_buffers),
+    m_bufferSize(default_buffer_size),
+    m_nbTransfers(default_nb_transfers),
+    m_streamTimeout(default_stream_timeout),
+    m_syncChanged(false),
     m_thread(0)
 {
     int status;
@@ -92,7 +99,7 @@ BladeRFSource::BladeRFSource(const char *serial) :
         }
         else
         {
-            if ((status = bladerf_sync_config(m_dev, BLADERF_MODULE_RX, BLADERF_FORMAT_SC16_Q11, 64, 8192, 32, 10000)) < 0)
+            if ((status = bladerf_sync_config(m_dev, BLADERF_MODULE_RX, BLADERF_FORMAT_SC16_Q11, m_nbBuffers, m_bufferSize, m_nbTransfers, m_streamTimeout)) < 0)
             {
                 std::ostringstream err_ostr;
                 err_ostr << "bladerf_sync_config failed with return code " << status;
@@ -167,8 +174,6 @@ BladeRFSource::BladeRFSource(const char *serial) :
     }
 
     m_bwfiltStr = bw_ostr.str();
-
-    m_this = this;
 }
 
 
@@ -178,8 +183,6 @@ BladeRFSource::~BladeRFSource()
     if (m_dev) {
         bladerf_close(m_dev);
     }
-
-    m_this = 0;
 }
 
 bool BladeRFSource::configure(parsekv::pairs_type& m)
@@ -349,6 +352,28 @@ bool BladeRFSource::configure(parsekv::pairs_type& m)
         changeFlags |= 0x2; // need to adjust actual center frequency if not centered
 	}
 
+	if (m.find("blklen") != m.end())
+	{
+		std::cerr << "BladeRFSource::configure: blklen: " << m["blklen"] << std::endl;
+		int block_size = atoi(m["blklen"].c_str());
+
+		if ((block_size < 1024) || (block_size > 1024*1024))
+		{
+			m_error = "Invalid block length";
+            std::cerr << "BladeRFSource::configure: " << m_error << std::endl;
+			return false;
+		}
+
+		m_blockSize = block_size;
+	}
+
+	if ((m.find("nbufs") != m.end()) || (m.find("bufsize") != m.end()) || (m.find("nxfers") != m.end()) || (m.find("stimeout") != m.end()))
+	{
+	    if (!configure_sync(m)) {
+	        return false;
+	    }
+	}
+
 	if (m.find("decim") != m.end())
 	{
 		std::cerr << "BladeRFSource::configure: decim: " << m["decim"] << std::endl;
@@ -381,6 +406,81 @@ bool BladeRFSource::configure(parsekv::pairs_type& m)
 	return configure(changeFlags, sample_rate, tuner_freq, bandwidth, lnaGainIndex, vga1Gain, vga2Gain);
 }
 
+/**
+ * Validate the parameters of the libbladeRF synchronous interface. These can
+ * only be applied while the Rx module is disabled so they take effect when
+ * streaming starts.
+ */
+bool BladeRFSource::configure_sync(parsekv::pairs_type& m)
+{
+    unsigned int nbBuffers = m_nbBuffers;
+    unsigned int bufferSize = m_bufferSize;
+    unsigned int nbTransfers = m_nbTransfers;
+    unsigned int streamTimeout = m_streamTimeout;
+
+    if (m_thread)
+    {
+        m_error = "Stream buffers cannot be changed while streaming";
+        std::cerr << "BladeRFSource::configure_sync: " << m_error << std::endl;
+        return false;
+    }
+
+    if (m.find("nbufs") != m.end())
+    {
+        std::cerr << "BladeRFSource::configure_sync: nbufs: " << m["nbufs"] << std::endl;
+        nbBuffers = atoi(m["nbufs"].c_str());
+    }
+
+    if (m.find("bufsize") != m.end())
+    {
+        std::cerr << "BladeRFSource::configure_sync: bufsize: " << m["bufsize"] << std::endl;
+        bufferSize = atoi(m["bufsize"].c_str());
+    }
+
+    if (m.find("nxfers") != m.end())
+    {
+        std::cerr << "BladeRFSource::configure_sync: nxfers: " << m["nxfers"] << std::endl;
+        nbTransfers = atoi(m["nxfers"].c_str());
+    }
+
+    if (m.find("stimeout") != m.end())
+    {
+        std::cerr << "BladeRFSource::configure_sync: stimeout: " << m["stimeout"] << std::endl;
+        streamTimeout = atoi(m["stimeout"].c_str());
+    }
+
+    if ((bufferSize < 1024) || (bufferSize % 1024 != 0) || (bufferSize > 1024*1024))
+    {
+        m_error = "Invalid stream buffer size. Must be a multiple of 1024 samples";
+    }
+    else if ((nbBuffers < 2) || (nbBuffers > 1024))
+    {
+        m_error = "Invalid number of stream buffers";
+    }
+    else if ((nbTransfers < 1) || (nbTransfers >= nbBuffers))
+    {
+        m_error = "Invalid number of transfers. Must be less than the number of buffers";
+    }
+    else if (streamTimeout == 0)
+    {
+        m_error = "Invalid stream timeout";
+    }
+
+    if (!m_error.empty())
+    {
+        std::cerr << "BladeRFSource::configure_sync: " << m_error << std::endl;
+        return false;
+    }
+
+    m_nbBuffers = nbBuffers;
+    m_bufferSize = bufferSize;
+    m_nbTransfers = nbTransfers;
+    m_streamTimeout = streamTimeout;
+    m_syncChanged = true;
+
+    return true;
+}
+
 // Configure RTL-SDR tuner and prepare for streaming.
 bool BladeRFSource::configure(uint32_t changeFlags,
         uint32_t sample_rate,
@@ -513,6 +613,9 @@ void BladeRFSource::print_specific_parms()
     fprintf(stderr, "LNA gain:          %d\n", m_lnaGain);
     fprintf(stderr, "VGA1 gain:         %d\n", m_vga1Gain);
     fprintf(stderr, "VGA2 gain:         %d\n", m_vga2Gain);
+    fprintf(stderr, "Block length:      %d samples\n", m_blockSize);
+    fprintf(stderr, "Stream buffers:    %u of %u samples, %u transfers, timeout %u ms\n",
+            m_nbBuffers, m_bufferSize, m_nbTransfers, m_streamTimeout);
 }
 
 bool BladeRFSource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag)
@@ -522,7 +625,46 @@ bool BladeRFSource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag
 
     if (m_thread == 0)
     {
-        m_thread = new std::thread(run);
+        if (m_syncChanged || (get_latency_ms() > 0))
+        {
+            int status;
+            unsigned int nbBuffers = m_nbBuffers;
+            unsigned int bufferSize = m_bufferSize;
+            unsigned int nbTransfers = m_nbTransfers;
+
+            // Stream buffers of the latency target at the current sample rate. Keep the
+            // configured ratio of transfers to buffers.
+            if (get_latency_ms() > 0)
+            {
+                bufferSize = latency_samples(1024, 1024, m_bufferSize);
+                nbBuffers = latency_buffers(bufferSize, m_nbBuffers, 1024);
+                nbTransfers = std::max(1U, std::min(nbBuffers - 1, (nbBuffers * m_nbTransfers) / m_nbBuffers));
+                std::cerr << "BladeRFSource::start: " << nbBuffers << " stream buffers of " << bufferSize
+                        << " samples, " << nbTransfers << " transfers" << std::endl;
+            }
+
+            bladerf_enable_module(m_dev, BLADERF_MODULE_RX, false);
+
+            if ((status = bladerf_sync_config(m_dev, BLADERF_MODULE_RX, BLADERF_FORMAT_SC16_Q11, nbBuffers, bufferSize, nbTransfers, m_streamTimeout)) < 0)
+            {
+                std::ostringstream err_ostr;
+                err_ostr << "bladerf_sync_config failed with return code " << status;
+                m_error = err_ostr.str();
+                return false;
+            }
+
+            if ((status = bladerf_enable_module(m_dev, BLADERF_MODULE_RX, true)) < 0)
+            {
+                std::ostringstream err_ostr;
+                err_ostr << "bladerf_enable_module failed with return code " << status;
+                m_error = err_ostr.str();
+                return false;
+            }
+
+            m_syncChanged = false;
+        }
+
+        m_thread = new std::thread(run, this);
         return true;
     }
     else
@@ -544,47 +686,52 @@ bool BladeRFSource::stop()
     return true;
 }
 
-void BladeRFSource::run()
+void BladeRFSource::run(BladeRFSource *source)
 {
+    ThreadConfig::apply("device");
     IQSampleVector iqsamples;
     void *msgBuf = 0;
 
-    while (!m_this->m_stop_flag->load() && get_samples(&iqsamples))
+    while (!source->m_stop_flag->load() && get_samples(source, &iqsamples))
     {
-        m_this->m_buf->push(move(iqsamples));
+        SampleStamp stamp = source->stamp_block(iqsamples.size());
+        source->m_buf->push(move(iqsamples), stamp);
 
-        int len = nn_recv(m_this->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+        int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
 
         if ((len > 0) && msgBuf)
         {
             std::string msg((char *) msgBuf, len);
             std::cerr << "BladeRFSource::run: received: " << msg << std::endl;
-            m_this->DeviceSource::configure(msg);
+            source->DeviceSource::configure(msg);
             nn_freemsg(msgBuf);
             msgBuf = 0;
         }
     }
 }
 
-// Fetch a bunch of samples from the device.
-bool BladeRFSource::get_samples(IQSampleVector *samples)
+/**
+ * Fetch a bunch of samples from the device.
+ *
+ * SC16 Q11 samples are interleaved int16 I/Q which is the memory layout of
+ * IQSample so libbladeRF copies them from its stream buffers straight into
+ * a block taken from the pool. Nothing is allocated once the pool is warm.
+ */
+bool BladeRFSource::get_samples(BladeRFSource *source, IQSampleVector *samples)
 {
     int res;
-    std::vector<int16_t> buf(2*m_blockSize);
+    unsigned int blockSize = source->latency_samples(1024, 1024, source->m_blockSize);
 
-    if ((res = bladerf_sync_rx(m_this->m_dev, buf.data(), m_blockSize, 0, 10000)) < 0)
-    {
-        m_this->m_error = "bladerf_sync_rx failed";
-        return false;
-    }
-
-    samples->resize(m_blockSize);
+    *samples = source->m_buf->get_block(blockSize);
 
-    for (int i = 0; i < m_blockSize; i++)
+    if ((res = bladerf_sync_rx(source->m_dev, samples->data(), blockSize, 0, source->m_streamTimeout)) < 0)
     {
-        int16_t re = buf[2*i];
-        int16_t im = buf[2*i+1];
-        (*samples)[i] = IQSample(re, im);
+        std::ostringstream err_ostr;
+        err_ostr << "bladerf_sync_rx failed: " << bladerf_strerror(res);
+        source->m_error = err_ostr.str();
+        source->m_buf->unget_block(std::move(*samples)); // not pushed: give the block back
+        samples->clear();
+        return false;
     }
 
     return true;
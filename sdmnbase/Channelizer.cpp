@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "Channelizer.h"
+#include "WorkerPool.h"
+
+static inline FixReal clip(float v)
+{
+    long s = lrintf(v);
+    s = std::max(s, (long) std::numeric_limits<FixReal>::min());
+    s = std::min(s, (long) std::numeric_limits<FixReal>::max());
+    return (FixReal) s;
+}
+
+Channelizer::Channelizer() :
+    m_nbChannels(0),
+    m_nbTaps(0),
+    m_phase(0),
+    m_index(0),
+    m_pool(0),
+    m_nbThreads(1)
+{
+}
+
+bool Channelizer::setNbChannels(unsigned int nbChannels)
+{
+    unsigned int log2Channels = 0;
+
+    while ((1U << log2Channels) < nbChannels) {
+        log2Channels++;
+    }
+
+    if ((nbChannels < 2) || (nbChannels > CHANNELIZER_MAX_CHANNELS) || ((1U << log2Channels) != nbChannels)) {
+        return false;
+    }
+
+    // prototype cut at half the channel spacing (-6 dB) with unity gain at DC
+    unsigned int len = nbChannels * CHANNELIZER_BRANCH_TAPS;
+    double fc = 0.5 / nbChannels;
+    double center = (len - 1) / 2.0;
+    std::vector<double> h(len);
+    double sum = 0.0;
+
+    for (unsigned int n = 0; n < len; n++)
+    {
+        double t = n - center;
+        double x = 2.0 * M_PI * n / (len - 1);
+        double window = 0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x);
+        h[n] = (t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t)) * window;
+        sum += h[n];
+    }
+
+    m_taps.resize(len);
+
+    for (unsigned int n = 0; n < len; n++) {
+        m_taps[len - 1 - n] = (float) (h[n] / sum);
+    }
+
+    // twiddles of each FFT stage in sequence: stage of half size n at index n - 1
+    m_twiddleRe.resize(nbChannels - 1);
+    m_twiddleIm.resize(nbChannels - 1);
+
+    for (unsigned int half = 1; half < nbChannels; half <<= 1)
+    {
+        for (unsigned int k = 0; k < half; k++)
+        {
+            m_twiddleRe[half - 1 + k] = (float) cos(M_PI * k / half);
+            m_twiddleIm[half - 1 + k] = (float) sin(M_PI * k / half);
+        }
+    }
+
+    m_reversed.resize(nbChannels);
+
+    for (unsigned int m = 0; m < nbChannels; m++)
+    {
+        unsigned int r = 0;
+
+        for (unsigned int b = 0; b < log2Channels; b++) {
+            r |= ((m >> b) & 1) << (log2Channels - 1 - b);
+        }
+
+        m_reversed[m] = r;
+    }
+
+    m_nbChannels = nbChannels;
+    m_nbTaps = len;
+    m_phase = 0;
+    m_index = len - 1;
+    m_re.assign(len - 1, 0.0f);
+    m_im.assign(len - 1, 0.0f);
+    setNbThreads(m_nbThreads);
+
+    return true;
+}
+
+double Channelizer::getChannelFrequency(unsigned int index) const
+{
+    return ((double) index - (double) (m_nbChannels / 2)) / m_nbChannels;
+}
+
+void Channelizer::setNbThreads(unsigned int nbThreads)
+{
+    nbThreads = std::max(nbThreads, 1U);
+
+    if ((nbThreads == m_nbThreads) && (m_work.size() == nbThreads) && (m_work[0].m_branchRe.size() == m_nbChannels)) {
+        return;
+    }
+
+    if (m_pool && (nbThreads > 1)) {
+        m_pool->reserve(nbThreads - 1);
+    }
+
+    m_nbThreads = nbThreads;
+    m_work.resize(nbThreads);
+
+    for (std::vector<Work>::iterator it = m_work.begin(); it != m_work.end(); ++it)
+    {
+        it->m_branchRe.resize(m_nbChannels);
+        it->m_branchIm.resize(m_nbChannels);
+        it->m_fftRe.resize(m_nbChannels);
+        it->m_fftIm.resize(m_nbChannels);
+    }
+}
+
+void Channelizer::process(const IQSampleVector& in, std::vector<IQSampleVector>& out)
+{
+    std::size_t history = m_nbTaps - 1;
+    std::size_t nbIn = in.size();
+    std::size_t end = history + nbIn;
+    std::size_t decim = m_nbChannels / 2;
+
+    m_re.resize(end);
+    m_im.resize(end);
+
+    for (std::size_t k = 0; k < nbIn; k++)
+    {
+        m_re[history + k] = in[k].real();
+        m_im[history + k] = in[k].imag();
+    }
+
+    std::size_t nbFrames = (m_index < end ? (end - 1 - m_index) / decim + 1 : 0);
+    out.resize(m_nbChannels);
+
+    for (unsigned int c = 0; c < m_nbChannels; c++) {
+        out[c].resize(nbFrames);
+    }
+
+    // a thread does not get less than CHANNELIZER_MIN_FRAMES output samples
+    unsigned int nbThreads = (m_pool ? m_nbThreads : 1);
+    unsigned int nbSegments = std::min((std::size_t) nbThreads, std::max(nbFrames / CHANNELIZER_MIN_FRAMES, (std::size_t) 1));
+
+    if (nbSegments > 1)
+    {
+        m_pool->run(nbSegments, [this, nbFrames, nbSegments, &out](unsigned int index) {
+            std::size_t first = (nbFrames * index) / nbSegments;
+            std::size_t last = (nbFrames * (index + 1)) / nbSegments;
+            processFrames(first, last - first, m_work[index], out);
+        });
+    }
+    else
+    {
+        processFrames(0, nbFrames, m_work[0], out);
+    }
+
+    m_index += nbFrames * decim;
+    m_phase = (m_phase + nbFrames * decim) & (m_nbChannels - 1);
+
+    // keep the last samples as history of the next block
+    std::copy(m_re.end() - history, m_re.end(), m_re.begin());
+    std::copy(m_im.end() - history, m_im.end(), m_im.begin());
+    m_index -= nbIn;
+}
+
+/** Add the products of n taps with n I/Q samples to the n branch sums */
+static void accumulate(const float * __restrict__ taps,
+        const float * __restrict__ re,
+        const float * __restrict__ im,
+        float * __restrict__ sumRe,
+        float * __restrict__ sumIm,
+        unsigned int n)
+{
+    for (unsigned int s = 0; s < n; s++)
+    {
+        sumRe[s] += taps[s] * re[s];
+        sumIm[s] += taps[s] * im[s];
+    }
+}
+
+/**
+ * Output samples first to first + count - 1 of all channels. For output sample f the
+ * last input sample is at t = index + f * N/2 and the window of the prototype starts
+ * nbTaps - 1 samples before. Branch s is the dot product of the window samples s + q*N
+ * with the same taps so that the N branches are computed together over contiguous
+ * samples. Channel k is then the inverse DFT of the branches taken from the last one
+ * and rotated by t modulo N which is the phase of the shift of channel k to 0 Hz.
+ */
+void Channelizer::processFrames(std::size_t first, std::size_t count, Work& work, std::vector<IQSampleVector>& out)
+{
+    unsigned int nbChannels = m_nbChannels;
+    unsigned int mask = nbChannels - 1;
+    std::size_t decim = nbChannels / 2;
+    float *branchRe = work.m_branchRe.data();
+    float *branchIm = work.m_branchIm.data();
+    float *fftRe = work.m_fftRe.data();
+    float *fftIm = work.m_fftIm.data();
+
+    for (std::size_t f = first; f < first + count; f++)
+    {
+        std::size_t index = m_index + f * decim;
+        unsigned int phase = (m_phase + f * decim) & mask;
+        const float *re = &m_re[index + 1 - m_nbTaps];
+        const float *im = &m_im[index + 1 - m_nbTaps];
+
+        for (unsigned int s = 0; s < nbChannels; s++)
+        {
+            branchRe[s] = 0.0f;
+            branchIm[s] = 0.0f;
+        }
+
+        for (unsigned int q = 0; q < CHANNELIZER_BRANCH_TAPS; q++) {
+            accumulate(&m_taps[q * nbChannels], &re[q * nbChannels], &im[q * nbChannels], branchRe, branchIm, nbChannels);
+        }
+
+        for (unsigned int m = 0; m < nbChannels; m++)
+        {
+            unsigned int s = (mask - m - phase) & mask;
+            fftRe[m_reversed[m]] = branchRe[s];
+            fftIm[m_reversed[m]] = branchIm[s];
+        }
+
+        fft(fftRe, fftIm);
+
+        for (unsigned int c = 0; c < nbChannels; c++)
+        {
+            unsigned int k = (c + nbChannels / 2) & mask; // increasing frequency order
+            out[c][f].setReal(clip(fftRe[k]));
+            out[c][f].setImag(clip(fftIm[k]));
+        }
+    }
+}
+
+/** Butterflies of one FFT stage group with b = a + half */
+static void butterflies(float * __restrict__ ar,
+        float * __restrict__ ai,
+        float * __restrict__ br,
+        float * __restrict__ bi,
+        const float * __restrict__ wr,
+        const float * __restrict__ wi,
+        unsigned int half)
+{
+    for (unsigned int k = 0; k < half; k++)
+    {
+        float tr = br[k] * wr[k] - bi[k] * wi[k];
+        float ti = br[k] * wi[k] + bi[k] * wr[k];
+        br[k] = ar[k] - tr;
+        bi[k] = ai[k] - ti;
+        ar[k] += tr;
+        ai[k] += ti;
+    }
+}
+
+/**
+ * In place radix 2 inverse FFT without scaling of inputs in bit reversed order. The
+ * first two stages whose twiddles are 1 and j are done together in one pass. The
+ * twiddles of the next stages are contiguous so that their butterflies are vectorized.
+ */
+void Channelizer::fft(float *re, float *im) const
+{
+    if (m_nbChannels == 2)
+    {
+        butterflies(&re[0], &im[0], &re[1], &im[1], &m_twiddleRe[0], &m_twiddleIm[0], 1);
+        return;
+    }
+
+    for (unsigned int start = 0; start < m_nbChannels; start += 4)
+    {
+        float *xr = &re[start];
+        float *xi = &im[start];
+        float r0 = xr[0] + xr[1], i0 = xi[0] + xi[1];
+        float r1 = xr[0] - xr[1], i1 = xi[0] - xi[1];
+        float r2 = xr[2] + xr[3], i2 = xi[2] + xi[3];
+        float r3 = xr[2] - xr[3], i3 = xi[2] - xi[3];
+        xr[0] = r0 + r2; xi[0] = i0 + i2;
+        xr[2] = r0 - r2; xi[2] = i0 - i2;
+        xr[1] = r1 - i3; xi[1] = i1 + r3; // + j * (r3 + j*i3)
+        xr[3] = r1 + i3; xi[3] = i1 - r3;
+    }
+
+    for (unsigned int half = 4; half < m_nbChannels; half <<= 1)
+    {
+        for (unsigned int start = 0; start < m_nbChannels; start += 2*half) {
+            butterflies(&re[start], &im[start], &re[start + half], &im[start + half], &m_twiddleRe[half - 1], &m_twiddleIm[half - 1], half);
+        }
+    }
+}
@@ -21,6 +21,7 @@
 #include "Downsampler.h"
 
 #include <iostream>
+#include <unistd.h>
 
 bool DeviceSource::configure(std::string& configureStr)
 {
@@ -65,8 +66,58 @@ bool DeviceSource::configure(std::string& configureStr)
             fprintf(stderr, "DeviceSource::configure: txdelay: %u us\n", m_txDelay);
         }
 
+        // size of device transfers
+
+        if (m.find("latency_ms") != m.end())
+        {
+            int latencyMs = atoi(m["latency_ms"].c_str());
+
+            if ((latencyMs < 0) || (latencyMs > 10000))
+            {
+                m_error = "Invalid latency. Valid values are 0 to 10000 ms";
+                return false;
+            }
+
+            m_latencyMs = latencyMs;
+            fprintf(stderr, "DeviceSource::configure: latency_ms: %u ms\n", m_latencyMs);
+        }
+
         // configuration for the source itself
 
         return configure(m);
     }
 }
+
+unsigned int DeviceSource::get_norm_shift()
+{
+    if (!m_normalize.load() || !m_downsampler) {
+        return 0;
+    }
+
+    if ((m_downsampler->getLog2Decimation() > 0) || m_downsampler->isResampling()) {
+        return 0;
+    }
+
+    return 16 - get_sample_bits();
+}
+
+void DeviceSource::push_waiting(IQSampleVector&& samples, const SampleStamp& stamp)
+{
+    std::size_t maxSamples = m_buf->capacity();
+
+    if (maxSamples == 0) {
+        maxSamples = DEVICESOURCE_MAX_QUEUED_BLOCKS * samples.size();
+    }
+
+    m_buf->wait_room(samples.size(), maxSamples);
+    m_buf->push(std::move(samples), stamp);
+}
+
+std::uint64_t DeviceSource::wait_consumed(std::uint64_t nbPushed)
+{
+    while ((m_buf->queued_samples() > 0) && !m_stop_flag->load()) {
+        usleep(1000);
+    }
+
+    return nbPushed - m_buf->queued_samples();
+}
@@ -16,17 +16,39 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.          //
 ///////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cstdlib>
+
 #include "Downsampler.h"
+#include "WorkerPool.h"
+
+#define DOWNSAMPLER_MAX_THREADS 16
 
 Downsampler::Downsampler(unsigned int decim,
-		fcPos_t fcPos) :
+		fcPos_t fcPos,
+		unsigned int nbThreads) :
 	m_decim(decim),
-	m_fcPos(fcPos)
+	m_fcPos(fcPos),
+	m_frequencyShift(0),
+	m_outputRateRequested(0),
+	m_sampleRate(0),
+	m_outputRate(0),
+	m_nbThreadsRequested(nbThreads),
+	m_nbThreads(1),
+	m_pool(0),
+	m_ownPool(0),
+	m_workDecim(0),
+	m_workFcPos(fcPos),
+	m_workMix(false),
+	m_workIn(0),
+	m_workOut(0)
 {
 }
 
 Downsampler::~Downsampler()
 {
+	setSegments(1);
+	delete m_ownPool;
 }
 
 bool Downsampler::configure(parsekv::pairs_type& m)
@@ -63,6 +85,60 @@ bool Downsampler::configure(parsekv::pairs_type& m)
 		}
 	}
 
+	if (m.find("fshift") != m.end())
+	{
+		std::cerr << "Downsampler::configure: fshift: " << m["fshift"] << std::endl;
+		int frequencyShift = atoi(m["fshift"].c_str());
+
+		if ((m_sampleRate != 0) && (2 * std::abs((int64_t) frequencyShift) > m_sampleRate))
+		{
+			m_error = "Frequency shift out of the device band";
+			return false;
+		}
+		else
+		{
+			m_frequencyShift = frequencyShift;
+		}
+	}
+
+	if (m.find("orate") != m.end())
+	{
+		std::cerr << "Downsampler::configure: orate: " << m["orate"] << std::endl;
+		int outputRate = atoi(m["orate"].c_str());
+
+		if (outputRate < 0)
+		{
+			m_error = "Invalid output sample rate";
+			return false;
+		}
+		else if ((outputRate > 0) && (m_sampleRate != 0)
+		      && ((uint64_t) outputRate * RATIONAL_RESAMPLER_MAX_RATIO < (m_sampleRate >> m_decim)))
+		{
+			m_error = "Output sample rate too low for the decimated rate";
+			return false;
+		}
+		else
+		{
+			m_outputRateRequested = outputRate;
+		}
+	}
+
+	if (m.find("dthreads") != m.end())
+	{
+		std::cerr << "Downsampler::configure: dthreads: " << m["dthreads"] << std::endl;
+		int nbThreads = atoi(m["dthreads"].c_str());
+
+		if ((nbThreads < 1) || (nbThreads > DOWNSAMPLER_MAX_THREADS))
+		{
+			m_error = "Invalid number of decimation threads";
+			return false;
+		}
+		else
+		{
+			m_nbThreadsRequested = nbThreads;
+		}
+	}
+
 	return true;
 }
 
@@ -71,92 +147,309 @@ void Downsampler::rescale(unsigned int& sampleSize, IQSampleVector& samples_inou
 	Decimators::decimate1(sampleSize, samples_inout); // rescale
 }
 
+void Downsampler::rescale(unsigned int sampleSize, const IQSample *in, IQSample *out, std::size_t len)
+{
+	Decimators::decimate1(sampleSize, in, out, len); // rescale
+}
+
 void Downsampler::process(unsigned int& sampleSize, const IQSampleVector& samples_in, IQSampleVector& samples_out)
 {
-	if (m_decim == 0)
+	if (m_nbThreadsRequested != m_nbThreads) {
+		setSegments(m_nbThreadsRequested);
+	}
+
+	unsigned int decim = m_decim; // may be changed by configure from the control thread
+	fcPos_t fcPos = m_fcPos;
+	uint32_t outputRate = m_outputRateRequested;
+	int frequencyShift = m_frequencyShift;
+	bool mix = (decim > 0) && (frequencyShift != 0) && (m_sampleRate != 0);
+
+	// the shift may have been configured before the sample rate was known
+	if (mix && (2 * std::abs((int64_t) frequencyShift) > m_sampleRate))
+	{
+		std::cerr << "Downsampler::process: frequency shift " << frequencyShift << " Hz out of the device band of "
+				<< m_sampleRate << " S/s: shift disabled" << std::endl;
+		m_frequencyShift = 0;
+		frequencyShift = 0;
+		mix = false;
+	}
+	IQSampleVector& decimated = (outputRate != 0 ? m_decimated : samples_out);
+
+	if (mix) {
+		setMixerFrequency(fcPos, frequencyShift);
+	}
+
+	if (decim == 0)
 	{
-		samples_out = samples_in;
-		Decimators::decimate1(sampleSize, samples_out); // rescale
+		decimated = samples_in;
+		Decimators::decimate1(sampleSize, decimated); // rescale
+	}
+	else if (m_nbThreads > 1)
+	{
+		processParallel(decim, fcPos, mix, sampleSize, samples_in, decimated);
 	}
 	else
 	{
-		if (m_fcPos == 0) // infra
-		{
-			switch (m_decim)
-			{
-			case 1:
-				Decimators::decimate2_inf(sampleSize, samples_in, samples_out);
-				break;
-			case 2:
-				Decimators::decimate4_inf(sampleSize, samples_in, samples_out);
-				break;
-			case 3:
-				m_decimators.decimate8_inf(sampleSize, samples_in, samples_out);
-				break;
-			case 4:
-				m_decimators.decimate16_inf(sampleSize, samples_in, samples_out);
-				break;
-			case 5:
-				m_decimators.decimate32_inf(sampleSize, samples_in, samples_out);
-				break;
-			case 6:
-				m_decimators.decimate64_inf(sampleSize, samples_in, samples_out);
-				break;
-			default:
-				break;
-			}
-		}
-		else if (m_fcPos == 1) // supra
-		{
-			switch (m_decim)
-			{
-			case 1:
-				Decimators::decimate2_sup(sampleSize, samples_in, samples_out);
-				break;
-			case 2:
-				Decimators::decimate4_sup(sampleSize, samples_in, samples_out);
-				break;
-			case 3:
-				m_decimators.decimate8_sup(sampleSize, samples_in, samples_out);
-				break;
-			case 4:
-				m_decimators.decimate16_sup(sampleSize, samples_in, samples_out);
-				break;
-			case 5:
-				m_decimators.decimate32_sup(sampleSize, samples_in, samples_out);
-				break;
-			case 6:
-				m_decimators.decimate64_sup(sampleSize, samples_in, samples_out);
-				break;
-			default:
-				break;
-			}
-		}
-		else // centered
-		{
-			switch (m_decim)
-			{
-			case 1:
-				m_decimators.decimate2_cen(sampleSize, samples_in, samples_out);
-				break;
-			case 2:
-				m_decimators.decimate4_cen(sampleSize, samples_in, samples_out);
-				break;
-			case 3:
-				m_decimators.decimate8_cen(sampleSize, samples_in, samples_out);
-				break;
-			case 4:
-				m_decimators.decimate16_cen(sampleSize, samples_in, samples_out);
-				break;
-			case 5:
-				m_decimators.decimate32_cen(sampleSize, samples_in, samples_out);
-				break;
-			case 6:
-				m_decimators.decimate64_cen(sampleSize, samples_in, samples_out);
-				break;
-			default:
-				break;
-			}
+		decimate(m_decimators, decim, fcPos, sampleSize, samples_in.data(), samples_in.size(), decimated, mix);
+	}
+
+	m_outputRate = m_sampleRate / (1<<decim);
+
+	if (outputRate != 0) {
+		resample(m_outputRate, outputRate, decimated, samples_out);
+	}
+}
+
+/**
+ * The mixer brings the wanted band center to 0 Hz. The shift is relative to the center
+ * of the band the center frequency position selects which is at -Fs/4 for the low band
+ * and +Fs/4 for the high band. The frequency is set again on each block as the sample
+ * rate may change while the phase is kept.
+ */
+void Downsampler::setMixerFrequency(fcPos_t fcPos, int frequencyShift)
+{
+	double frequency = frequencyShift;
+
+	if (fcPos == FC_POS_INFRA) {
+		frequency -= m_sampleRate / 4.0;
+	} else if (fcPos == FC_POS_SUPRA) {
+		frequency += m_sampleRate / 4.0;
+	}
+
+	m_decimators.mixer().setFrequency(-frequency, m_sampleRate);
+}
+
+/**
+ * Resample the output of the halfband chain to the configured output rate. The
+ * filter is designed again when either rate changes. When the ratio is not
+ * supported resampling is disabled and the decimated samples are passed through.
+ */
+void Downsampler::resample(uint32_t inputRate, uint32_t outputRate, const IQSampleVector& samples_in, IQSampleVector& samples_out)
+{
+	if ((inputRate != m_resampler.getInputRate()) || (outputRate != m_resampler.getOutputRate()))
+	{
+		if (m_resampler.setRates(inputRate, outputRate))
+		{
+			std::cerr << "Downsampler::resample: " << inputRate << " to " << outputRate << " S/s: L/M = "
+					<< m_resampler.getInterpolation() << "/" << m_resampler.getDecimation()
+					<< " with " << m_resampler.getNbTaps() << " taps per phase" << std::endl;
+		}
+		else
+		{
+			std::cerr << "Downsampler::resample: cannot resample " << inputRate << " to " << outputRate
+					<< " S/s: resampling disabled" << std::endl;
+			m_outputRateRequested = 0;
+			samples_out = samples_in;
+			return;
+		}
+	}
+
+	m_resampler.process(samples_in, samples_out);
+	m_outputRate = outputRate;
+}
+
+void Downsampler::decimate(Decimators& decimators,
+		unsigned int decim,
+		fcPos_t fcPos,
+		unsigned int& sampleSize,
+		const IQSample *samples_in,
+		std::size_t len,
+		IQSampleVector& samples_out,
+		bool mix)
+{
+	if (mix)
+	{
+		decimators.decimate_mixed(decim, sampleSize, samples_in, len, samples_out);
+	}
+	else if (fcPos == FC_POS_INFRA)
+	{
+		switch (decim)
+		{
+		case 1:
+			Decimators::decimate2_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		case 2:
+			Decimators::decimate4_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		case 3:
+			decimators.decimate8_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		case 4:
+			decimators.decimate16_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		case 5:
+			decimators.decimate32_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		case 6:
+			decimators.decimate64_inf(sampleSize, samples_in, len, samples_out);
+			break;
+		default:
+			break;
+		}
+	}
+	else if (fcPos == FC_POS_SUPRA)
+	{
+		switch (decim)
+		{
+		case 1:
+			Decimators::decimate2_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		case 2:
+			Decimators::decimate4_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		case 3:
+			decimators.decimate8_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		case 4:
+			decimators.decimate16_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		case 5:
+			decimators.decimate32_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		case 6:
+			decimators.decimate64_sup(sampleSize, samples_in, len, samples_out);
+			break;
+		default:
+			break;
+		}
+	}
+	else // centered
+	{
+		switch (decim)
+		{
+		case 1:
+			decimators.decimate2_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		case 2:
+			decimators.decimate4_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		case 3:
+			decimators.decimate8_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		case 4:
+			decimators.decimate16_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		case 5:
+			decimators.decimate32_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		case 6:
+			decimators.decimate64_cen(sampleSize, samples_in, len, samples_out);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/**
+ * The block is cut in segments decimated concurrently each with its own
+ * decimators. The halfband filters only remember their last order inputs so
+ * the output of a stage only depends on the last order << log2Decim input
+ * samples. Each segment but the first is therefore decimated after the samples
+ * that precede it in the block and the output of this warm up part is discarded.
+ * The first segment continues with the decimators state left by the previous
+ * block which is the state of the last segment once it has been flushed. The
+ * result is the same as the one of a single decimators instance.
+ *
+ * Segments start on a boundary of the decimators processing loop. The samples
+ * that do not fill a full loop at the end of the block are dropped, like the
+ * single thread decimation does. A block too short for two segments is decimated
+ * in one go by the main thread.
+ *
+ * When mixing the mixer of each segment but the first starts from the one of the
+ * block advanced to the first warm up sample. The mixer sets its oscillator from
+ * its phase every Nco::anchor_length samples from the start of the block so the
+ * segments and their warm up start on these anchors and the phase is advanced in
+ * the same steps: the mixed samples are exactly the single thread ones.
+ */
+void Downsampler::processParallel(unsigned int decim, fcPos_t fcPos, bool mix, unsigned int& sampleSize, const IQSampleVector& samples_in, IQSampleVector& samples_out)
+{
+	// input samples consumed by one decimators loop: the low and high band decimation
+	// by 2 works on groups of 4 samples and the others on groups of 1 << decim samples
+	std::size_t quantum = ((decim == 1) && !mix && (fcPos != FC_POS_CENTER) ? 4 : 1U << decim);
+	std::size_t warmup = DECIMATORS_HB_FILTER_ORDER << decim;
+	std::size_t len = samples_in.size() - (samples_in.size() % quantum);
+
+	if (mix)
+	{
+		// segments and their warm up start on the mixer anchors of the single thread decimation
+		quantum = Nco::anchor_length;
+		warmup = ((warmup + quantum - 1) / quantum) * quantum;
+	}
+
+	// segments shorter than the warm up would spend more time warming up than decimating
+	unsigned int nbSegments = std::min((std::size_t) m_nbThreads, std::max(len / warmup, (std::size_t) 1));
+
+	if (nbSegments == 1)
+	{
+		decimate(m_decimators, decim, fcPos, sampleSize, samples_in.data(), samples_in.size(), samples_out, mix);
+		return;
+	}
+	std::size_t segmentLength = ((len / nbSegments) / quantum) * quantum;
+
+	for (unsigned int i = 0; i < nbSegments; i++)
+	{
+		m_segments[i]->m_start = i * segmentLength;
+		m_segments[i]->m_length = (i == nbSegments - 1 ? len - i * segmentLength : segmentLength);
+		m_segments[i]->m_warmup = (i == 0 ? 0 : warmup);
+		m_segments[i]->m_sampleSize = sampleSize;
+
+		if (mix && (i > 0))
+		{
+			m_segments[i]->m_decimators.mixer() = m_decimators.mixer();
+			m_segments[i]->m_decimators.mixer().skip(m_segments[i]->m_start - m_segments[i]->m_warmup);
 		}
 	}
+
+	samples_out.resize(len >> decim);
+
+	m_workDecim = decim;
+	m_workFcPos = fcPos;
+	m_workMix = mix;
+	m_workIn = &samples_in;
+	m_workOut = &samples_out;
+
+	m_pool->run(nbSegments, [this](unsigned int index) { decimateSegment(index); });
+
+	sampleSize = m_segments[0]->m_sampleSize;
+	m_decimators = m_segments[nbSegments - 1]->m_decimators; // state at the end of the block
+}
+
+void Downsampler::decimateSegment(unsigned int index)
+{
+	Segment *segment = m_segments[index];
+	Decimators& decimators = (index == 0 ? m_decimators : segment->m_decimators);
+	const IQSampleVector& samples_in = *m_workIn;
+	std::size_t begin = segment->m_start - segment->m_warmup;
+	std::size_t end = segment->m_start + segment->m_length;
+
+	decimate(decimators, m_workDecim, m_workFcPos, segment->m_sampleSize, samples_in.data() + begin, end - begin, segment->m_out, m_workMix);
+
+	std::copy(segment->m_out.begin() + (segment->m_warmup >> m_workDecim),
+			segment->m_out.begin() + ((end - begin) >> m_workDecim),
+			m_workOut->begin() + (segment->m_start >> m_workDecim));
+}
+
+void Downsampler::setSegments(unsigned int nbThreads)
+{
+	for (std::vector<Segment*>::iterator it = m_segments.begin(); it != m_segments.end(); ++it) {
+		delete *it;
+	}
+
+	m_segments.clear();
+	m_nbThreads = nbThreads;
+
+	if (nbThreads < 2) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < nbThreads; i++) {
+		m_segments.push_back(new Segment());
+	}
+
+	if (!m_pool) {
+		m_pool = m_ownPool = new WorkerPool();
+	}
+
+	m_pool->reserve(nbThreads - 1);
 }
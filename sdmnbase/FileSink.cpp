@@ -28,6 +28,7 @@
 
 #include "FileSink.h"
 #include "util.h"
+#include "ThreadConfig.h"
 #include "parsekv.h"
 #include "UDPSource.h"
 
@@ -216,6 +217,7 @@ bool FileSink::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
 void FileSink::run(std::atomic_bool *stop_flag)
 {
     std::cerr << "FileSink::run" << std::endl;
+    ThreadConfig::apply("device");
     void *msgBuf = 0;
     unsigned int count = 0;
     char msgBufSend[128];
@@ -241,7 +243,8 @@ void FileSink::run(std::atomic_bool *stop_flag)
         if (m_this->m_buf->queued_samples() > 0)
         {
             fprintf(stderr, "FileSink::run: %lu samples left in queue\n", m_this->m_buf->queued_samples());
-            m_this->m_iqSamples = m_this->m_buf->pull();
+            m_this->m_buf->recycle(std::move(m_this->m_iqSamples));
+            m_this->m_buf->pull(m_this->m_iqSamples);
             m_this->m_ofstream.write(reinterpret_cast<char*>(&(m_this->m_iqSamples[0])), m_this->m_iqSamples.size()*2*sizeof(int16_t));
         }
 
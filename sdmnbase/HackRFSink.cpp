@@ -26,6 +26,7 @@
 
 #include "HackRFSink.h"
 #include "util.h"
+#include "ThreadConfig.h"
 #include "parsekv.h"
 #include "UDPSource.h"
 
@@ -547,6 +548,7 @@ bool HackRFSink::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
 void HackRFSink::run(hackrf_device* dev, std::atomic_bool *stop_flag)
 {
     std::cerr << "HackRFSink::run" << std::endl;
+    ThreadConfig::apply("control");
     void *msgBuf = 0;
     char msgBufSend[128];
 
@@ -648,6 +650,7 @@ int HackRFSink::tx_callback(hackrf_transfer* transfer)
 
 void HackRFSink::callback(char* buf, int len)
 {
+    ThreadConfig::applyOnce("device");
     int i = 0;
 
     for (; i < len/2; i++)
@@ -656,7 +659,8 @@ void HackRFSink::callback(char* buf, int len)
         {
             if (m_buf->test_buffer_fill((len/2) - i))
             {
-                m_iqSamples = m_buf->pull();
+                m_buf->recycle(std::move(m_iqSamples));
+                m_buf->pull(m_iqSamples);
 //                fprintf(stderr, "HackRFSink::callback: len: %d, pull size: %lu, queue size: %lu\n", len, m_iqSamples.size(), m_buf->queued_vectors());
                 m_iqSamplesIndex = 0;
             }
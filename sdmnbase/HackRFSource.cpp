@@ -25,9 +25,13 @@
 
 #include "HackRFSource.h"
 #include "util.h"
+#include "ThreadConfig.h"
+#include "SampleConverter.h"
 #include "parsekv.h"
 
-HackRFSource *HackRFSource::m_this = 0;
+std::mutex HackRFSource::m_libraryMutex;
+int HackRFSource::m_libraryUsers = 0;
+
 const std::vector<int> HackRFSource::m_lgains({0, 8, 16, 24, 32, 40});
 const std::vector<int> HackRFSource::m_vgains({0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30, 32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62});
 const std::vector<int> HackRFSource::m_bwfilt({1750000, 2500000, 3500000, 5000000, 5500000, 6000000, 7000000,  8000000, 9000000, 10000000, 12000000, 14000000, 15000000, 20000000, 24000000, 28000000});
@@ -44,9 +48,10 @@ HackRFSource::HackRFSource(int dev_index) :
     m_extAmp(false),
     m_biasAnt(false),
     m_running(false),
-    m_thread(0)
+    m_thread(0),
+    m_libraryInit(false)
 {
-    hackrf_error rc = (hackrf_error) hackrf_init();
+    hackrf_error rc = library_init();
 
     if (rc != HACKRF_SUCCESS)
     {
@@ -57,6 +62,8 @@ HackRFSource::HackRFSource(int dev_index) :
     }
     else
     {
+        m_libraryInit = true;
+
         hackrf_device_list_t *hackrf_devices = hackrf_device_list();
 
         rc = (hackrf_error) hackrf_device_list_open(hackrf_devices, dev_index, &m_dev);
@@ -68,6 +75,8 @@ HackRFSource::HackRFSource(int dev_index) :
             m_error = err_ostr.str();
             m_dev = 0;
         }
+
+        hackrf_device_list_free(hackrf_devices);
     }
 
     std::ostringstream lgains_ostr;
@@ -94,8 +103,6 @@ HackRFSource::HackRFSource(int dev_index) :
     }
 
     m_bwfiltStr = bwfilt_ostr.str();
-
-    m_this = this;
 }
 
 HackRFSource::~HackRFSource()
@@ -104,20 +111,47 @@ HackRFSource::~HackRFSource()
         hackrf_close(m_dev);
     }
 
-    hackrf_error rc = (hackrf_error) hackrf_exit();
-    std::cerr << "HackRFSource::~HackRFSource: HackRF library exit: " << rc << ": " << hackrf_error_name(rc) << std::endl;
+    if (m_libraryInit)
+    {
+        hackrf_error rc = library_exit();
+        std::cerr << "HackRFSource::~HackRFSource: HackRF library exit: " << rc << ": " << hackrf_error_name(rc) << std::endl;
+    }
+}
+
+hackrf_error HackRFSource::library_init()
+{
+    std::unique_lock<std::mutex> lock(m_libraryMutex);
+
+    if (m_libraryUsers == 0)
+    {
+        hackrf_error rc = (hackrf_error) hackrf_init();
+
+        if (rc != HACKRF_SUCCESS) {
+            return rc;
+        }
+    }
+
+    m_libraryUsers++;
+    return HACKRF_SUCCESS;
+}
+
+hackrf_error HackRFSource::library_exit()
+{
+    std::unique_lock<std::mutex> lock(m_libraryMutex);
+
+    if (--m_libraryUsers > 0) {
+        return HACKRF_SUCCESS; // still used
+    }
 
-    m_this = 0;
+    return (hackrf_error) hackrf_exit();
 }
 
 void HackRFSource::get_device_names(std::vector<std::string>& devices)
 {
-    hackrf_device *hackrf_ptr;
-    read_partid_serialno_t read_partid_serialno;
     hackrf_error rc;
     int i;
 
-    rc = (hackrf_error) hackrf_init();
+    rc = library_init();
 
     if (rc != HACKRF_SUCCESS)
     {
@@ -129,42 +163,29 @@ void HackRFSource::get_device_names(std::vector<std::string>& devices)
 
     devices.clear();
 
+    // Take the serial numbers from the USB descriptors rather than opening the devices
+    // so that every device of the list is named including those already opened and the
+    // index given to the constructor is the one of the list.
     for (i=0; i < hackrf_devices->devicecount; i++)
     {
-        rc = (hackrf_error) hackrf_device_list_open(hackrf_devices, i, &hackrf_ptr);
+        std::ostringstream devname_ostr;
+        const char *serial = hackrf_devices->serial_numbers[i];
 
-        if (rc == HACKRF_SUCCESS)
+        if (serial)
         {
-            std::cerr << "HackRFSource::get_device_names: try to get device " << i << " serial number" << std::endl;
-            rc = (hackrf_error) hackrf_board_partid_serialno_read(hackrf_ptr, &read_partid_serialno);
-
-            if (rc != HACKRF_SUCCESS)
-            {
-                std::cerr << "HackRFSource::get_device_names: failed to get device " << i << " serial number: " << rc << ": " << hackrf_error_name(rc) << std::endl;
-                hackrf_close(hackrf_ptr);
-                continue;
-            }
-            else
-            {
-                std::cerr << "HackRFSource::get_device_names: device " << i << " OK" << std::endl;
-                hackrf_close(hackrf_ptr);
-            }
-
-            uint32_t serial_msb = read_partid_serialno.serial_no[2];
-            uint32_t serial_lsb = read_partid_serialno.serial_no[3];
-            std::ostringstream devname_ostr;
-
-            devname_ostr << "Serial " << std::hex << std::setw(8) << std::setfill('0') << serial_msb << serial_lsb;
-            devices.push_back(devname_ostr.str());
+            std::size_t len = strlen(serial);
+            devname_ostr << "Serial " << (len > 16 ? serial + len - 16 : serial); // the 64 bits shown on the board
         }
         else
         {
-            std::cerr << "HackRFSource::get_device_names: failed to open device " << i << std::endl;
+            devname_ostr << "Serial unknown";
         }
+
+        devices.push_back(devname_ostr.str());
     }
 
     hackrf_device_list_free(hackrf_devices);
-    rc = (hackrf_error) hackrf_exit();
+    rc = library_exit();
     std::cerr << "HackRFSource::get_device_names: HackRF library exit: " << rc << ": " << hackrf_error_name(rc) << std::endl;
 }
 
@@ -587,7 +608,7 @@ bool HackRFSource::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
     {
         std::cerr << "HackRFSource::start: starting" << std::endl;
         m_running = true;
-        m_thread = new std::thread(run, m_dev, stop_flag);
+        m_thread = new std::thread(run, this);
         sleep(1);
         return *this;
     }
@@ -599,12 +620,15 @@ bool HackRFSource::start(DataBuffer<IQSample> *buf, std::atomic_bool *stop_flag)
     }
 }
 
-void HackRFSource::run(hackrf_device* dev, std::atomic_bool *stop_flag)
+void HackRFSource::run(HackRFSource *source)
 {
+    hackrf_device *dev = source->m_dev;
+    std::atomic_bool *stop_flag = source->m_stop_flag;
     std::cerr << "HackRFSource::run" << std::endl;
+    ThreadConfig::apply("control");
     void *msgBuf = 0;
 
-    hackrf_error rc = (hackrf_error) hackrf_start_rx(dev, rx_callback, 0);
+    hackrf_error rc = (hackrf_error) hackrf_start_rx(dev, rx_callback, (void *) source);
 
     if (rc == HACKRF_SUCCESS)
     {
@@ -612,13 +636,13 @@ void HackRFSource::run(hackrf_device* dev, std::atomic_bool *stop_flag)
         {
             sleep(1);
 
-            int len = nn_recv(m_this->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+            int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
 
             if ((len > 0) && msgBuf)
             {
                 std::string msg((char *) msgBuf, len);
                 std::cerr << "HackRFSource::run: received: " << msg << std::endl;
-                m_this->DeviceSource::configure(msg);
+                source->DeviceSource::configure(msg);
                 nn_freemsg(msgBuf);
                 msgBuf = 0;
             }
@@ -650,9 +674,11 @@ int HackRFSource::rx_callback(hackrf_transfer* transfer)
 {
     int bytes_to_write = transfer->valid_length;
 
-    if (m_this)
+    HackRFSource *source = (HackRFSource *) transfer->rx_ctx;
+
+    if (source)
     {
-        m_this->callback((signed char *) transfer->buffer, bytes_to_write);
+        source->callback((signed char *) transfer->buffer, bytes_to_write);
     }
 
     return 0;
@@ -660,15 +686,10 @@ int HackRFSource::rx_callback(hackrf_transfer* transfer)
 
 void HackRFSource::callback(const signed char* buf, int len)
 {
-    IQSampleVector iqsamples;
-
-    iqsamples.resize(len/2);
-
-    for (int i = 0; i < len/2; i++)
-    {
-        iqsamples[i]   = IQSample(buf[2*i],   buf[2*i+1]);
-//        iqsamples[2*i+1] = IQSample(buf[4*i+2], buf[4*i+3]);
-    }
-
-    m_buf->push(move(iqsamples));
+    ThreadConfig::applyOnce("device");
+    unsigned int normShift = get_norm_shift();
+    SampleStamp stamp = stamp_block(len/2, normShift);
+    IQSampleVector iqsamples = m_buf->get_block(len/2);
+    SampleConverter::convertS8((const int8_t *) buf, iqsamples.data(), len/2, normShift);
+    m_buf->push(move(iqsamples), stamp);
 }
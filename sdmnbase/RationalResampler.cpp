@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "RationalResampler.h"
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+static inline FixReal clip(float v)
+{
+    long s = lrintf(v);
+    s = std::max(s, (long) std::numeric_limits<FixReal>::min());
+    s = std::min(s, (long) std::numeric_limits<FixReal>::max());
+    return (FixReal) s;
+}
+
+RationalResampler::RationalResampler() :
+    m_inputRate(0),
+    m_outputRate(0),
+    m_interp(1),
+    m_decim(1),
+    m_nbTaps(1),
+    m_phase(0),
+    m_index(0)
+{
+}
+
+bool RationalResampler::setRates(uint32_t inputRate, uint32_t outputRate)
+{
+    m_inputRate = 0;
+    m_outputRate = 0;
+
+    if ((inputRate == 0) || (outputRate == 0) || (outputRate > inputRate)
+     || ((uint64_t) outputRate * RATIONAL_RESAMPLER_MAX_RATIO < inputRate)) {
+        return false;
+    }
+
+    uint32_t d = gcd(inputRate, outputRate);
+    unsigned int interp = outputRate / d;
+    unsigned int decim = inputRate / d;
+
+    if (interp > RATIONAL_RESAMPLER_MAX_PHASES) {
+        return false;
+    }
+
+    m_interp = interp;
+    m_decim = decim;
+
+    if (decim == 1) // same rates
+    {
+        m_nbTaps = 1;
+        m_taps.assign(1, 1.0f);
+    }
+    else
+    {
+        // prototype at L times the input rate: cutoff below the output Nyquist frequency
+        // and length rounded up to a multiple of L
+        double fc = RATIONAL_RESAMPLER_PASSBAND * 0.5 / std::max(interp, decim);
+        unsigned int nbTaps = (2 * RATIONAL_RESAMPLER_ZERO_CROSSINGS * std::max(interp, decim)) / interp + 1;
+        unsigned int len = nbTaps * interp;
+        double center = (len - 1) / 2.0;
+        std::vector<double> h(len);
+        double sum = 0.0;
+
+        for (unsigned int n = 0; n < len; n++)
+        {
+            double t = n - center;
+            double x = 2.0 * M_PI * n / (len - 1);
+            double window = 0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x);
+            h[n] = (t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t)) * window;
+            sum += h[n];
+        }
+
+        // unity gain of each phase at DC: the interpolation gain L is compensated
+        m_nbTaps = nbTaps;
+        m_taps.resize(len);
+
+        for (unsigned int p = 0; p < interp; p++)
+        {
+            for (unsigned int k = 0; k < nbTaps; k++) {
+                m_taps[p*nbTaps + (nbTaps - 1 - k)] = (float) (h[p + k*interp] * interp / sum);
+            }
+        }
+    }
+
+    m_phase = 0;
+    m_index = m_nbTaps - 1;
+    m_re.assign(m_nbTaps - 1, 0.0f);
+    m_im.assign(m_nbTaps - 1, 0.0f);
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+
+    return true;
+}
+
+void RationalResampler::process(const IQSampleVector& in, IQSampleVector& out)
+{
+    std::size_t history = m_nbTaps - 1;
+    std::size_t nbIn = in.size();
+    std::size_t end = history + nbIn;
+
+    m_re.resize(end);
+    m_im.resize(end);
+
+    for (std::size_t k = 0; k < nbIn; k++)
+    {
+        m_re[history + k] = in[k].real();
+        m_im[history + k] = in[k].imag();
+    }
+
+    // when M/L exceeds the block size the next output sample may be past this block
+    out.resize(m_index < end ? ((end - m_index) * m_interp) / m_decim + 1 : 0);
+    std::size_t nbOut = 0;
+
+    while (m_index < end)
+    {
+        const float *h = &m_taps[m_phase * m_nbTaps];
+        const float *re = &m_re[m_index - history];
+        const float *im = &m_im[m_index - history];
+        float accRe = 0.0f;
+        float accIm = 0.0f;
+
+        for (unsigned int k = 0; k < m_nbTaps; k++)
+        {
+            accRe += h[k] * re[k];
+            accIm += h[k] * im[k];
+        }
+
+        out[nbOut].setReal(clip(accRe));
+        out[nbOut].setImag(clip(accIm));
+        nbOut++;
+
+        m_phase += m_decim;
+        m_index += m_phase / m_interp;
+        m_phase %= m_interp;
+    }
+
+    out.resize(nbOut);
+
+    // keep the last samples as history of the next block
+    std::copy(m_re.end() - history, m_re.end(), m_re.begin());
+    std::copy(m_im.end() - history, m_im.end(), m_im.begin());
+    m_index -= nbIn;
+}
@@ -0,0 +1,548 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "ReplaySource.h"
+#include "util.h"
+#include "ThreadConfig.h"
+#include "SampleConverter.h"
+#include "parsekv.h"
+
+// Open replay device.
+ReplaySource::ReplaySource(int dev_index) :
+    m_dev(dev_index),
+    m_format(FormatU8),
+    m_map(0),
+    m_mapSize(0),
+    m_data(0),
+    m_nbSamples(0),
+    m_sampleIndex(0),
+    m_sampleBytes(1),
+    m_sampleBits(8),
+    m_srate(1000000),
+    m_freq(435000000),
+    m_speed(1.0),
+    m_loop(false),
+    m_headerParams(false),
+    m_block_length(default_block_length),
+    m_thread(0)
+{
+    m_confFreq = m_freq;
+}
+
+// Close replay device.
+ReplaySource::~ReplaySource()
+{
+    closeFile();
+}
+
+bool ReplaySource::configure(parsekv::pairs_type& m)
+{
+    Format format = m_format;
+    bool reopen = false;
+
+    if (m.find("format") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): format: " << m["format"] << std::endl;
+        std::string formatStr = m["format"];
+
+        if (formatStr == "u8") {
+            format = FormatU8;
+        } else if (formatStr == "s8") {
+            format = FormatS8;
+        } else if (formatStr == "s16") {
+            format = FormatS16;
+        } else if (formatStr == "sdriq") {
+            format = FormatSDRIQ;
+        }
+        else
+        {
+            m_error = "Invalid file format";
+            return false;
+        }
+
+        reopen = true;
+    }
+
+    if (m.find("file") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): file: " << m["file"] << std::endl;
+        m_filename = m["file"];
+        reopen = true;
+    }
+
+    if (reopen)
+    {
+        if (m_thread)
+        {
+            m_error = "Cannot change file while streaming";
+            return false;
+        }
+
+        if (m_filename.empty()) {
+            m_format = format;
+        } else if (!openFile(m_filename, format)) {
+            return false;
+        }
+    }
+
+    if (m.find("bits") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): bits: " << m["bits"] << std::endl;
+        int bits = atoi(m["bits"].c_str());
+
+        if ((bits < 1) || (bits > (int) (8 * m_sampleBytes)))
+        {
+            m_error = "Invalid number of bits per sample";
+            return false;
+        }
+
+        m_sampleBits = bits;
+    }
+
+    if (m.find("srate") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): srate: " << m["srate"] << std::endl;
+        int sample_rate = atoi(m["srate"].c_str());
+
+        if ((sample_rate < 8000) || (sample_rate > 100000000))
+        {
+            m_error = "Invalid sample rate";
+            return false;
+        }
+
+        if (m_headerParams) {
+            std::cerr << "ReplaySource::configure(m): srate: overrides file header" << std::endl;
+        }
+
+        m_srate = sample_rate;
+    }
+
+    if (m.find("freq") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): freq: " << m["freq"] << std::endl;
+        uint64_t frequency = strtoull(m["freq"].c_str(), 0, 10);
+
+        if (frequency < 10000)
+        {
+            m_error = "Invalid frequency";
+            return false;
+        }
+
+        m_freq = frequency;
+    }
+
+    if (m.find("speed") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): speed: " << m["speed"] << std::endl;
+        float speed = atof(m["speed"].c_str());
+
+        if (speed < 0.0)
+        {
+            m_error = "Invalid replay speed";
+            return false;
+        }
+
+        m_speed = speed;
+    }
+
+    if (m.find("loop") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): loop" << std::endl;
+        m_loop = true;
+    }
+
+    if (m.find("blklen") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): blklen: " << m["blklen"] << std::endl;
+        int block_length = atoi(m["blklen"].c_str());
+        m_block_length = (block_length < 4096) ? 4096 :
+                         (block_length > 1024 * 1024) ? 1024 * 1024 :
+                         block_length;
+    }
+
+    if (m.find("fcpos") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): fcpos: " << m["fcpos"] << std::endl;
+        int fcpos = atoi(m["fcpos"].c_str());
+
+        if ((fcpos < 0) || (fcpos > 2))
+        {
+            m_error = "Invalid center frequency position";
+            return false;
+        }
+
+        m_fcPos = fcpos;
+    }
+
+    if (m.find("decim") != m.end())
+    {
+        std::cerr << "ReplaySource::configure(m): decim: " << m["decim"] << std::endl;
+        int log2Decim = atoi(m["decim"].c_str());
+
+        if ((log2Decim < 0) || (log2Decim > 6))
+        {
+            m_error = "Invalid log2 decimation factor";
+            return false;
+        }
+
+        m_decim = log2Decim;
+    }
+
+    // The recording cannot be retuned so the frequency sent is the center of the selected band
+    if (m_fcPos == 0) { // Infradyne
+        m_confFreq = m_freq - 0.25 * m_srate;
+    } else if (m_fcPos == 1) { // Supradyne
+        m_confFreq = m_freq + 0.25 * m_srate;
+    } else { // Centered
+        m_confFreq = m_freq;
+    }
+
+    return true;
+}
+
+bool ReplaySource::openFile(const std::string& filename, Format format)
+{
+    closeFile();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        m_error = "Cannot open " + filename + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+
+    if ((fstat(fd, &st) < 0) || (st.st_size == 0))
+    {
+        m_error = "Cannot replay empty file " + filename;
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid
+
+    if (map == MAP_FAILED)
+    {
+        m_error = "Cannot map " + filename + ": " + strerror(errno);
+        return false;
+    }
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    m_map = (const uint8_t *) map;
+    m_mapSize = st.st_size;
+    m_headerParams = false;
+
+    std::size_t headerSize = 0;
+    const Header *header = (const Header *) m_map;
+
+    if ((m_mapSize >= sizeof(Header)) && (memcmp(header->m_magic, "SDMNIQ", 6) == 0))
+    {
+        if (header->m_format > FormatS16)
+        {
+            m_error = "Invalid format in header of " + filename;
+            closeFile();
+            return false;
+        }
+
+        if ((header->m_sampleRate < 8000) || (header->m_sampleRate > 100000000))
+        {
+            m_error = "Invalid sample rate in header of " + filename;
+            closeFile();
+            return false;
+        }
+
+        format = (Format) header->m_format;
+        m_sampleBits = header->m_sampleBits;
+        m_srate = header->m_sampleRate;
+        m_freq = header->m_centerFrequency;
+        m_headerParams = true;
+        headerSize = sizeof(Header);
+    }
+    else if (format == FormatSDRIQ)
+    {
+        int32_t sampleRate;
+        uint64_t centerFrequency;
+
+        headerSize = sizeof(int32_t) + sizeof(uint64_t) + sizeof(std::time_t);
+
+        if (m_mapSize < headerSize)
+        {
+            m_error = "Invalid sdriq file " + filename;
+            closeFile();
+            return false;
+        }
+
+        memcpy(&sampleRate, m_map, sizeof(int32_t));
+        memcpy(&centerFrequency, m_map + sizeof(int32_t), sizeof(uint64_t));
+
+        if ((sampleRate < 8000) || (sampleRate > 100000000))
+        {
+            m_error = "Invalid sample rate in header of " + filename;
+            closeFile();
+            return false;
+        }
+
+        m_srate = sampleRate;
+        m_freq = centerFrequency;
+        m_sampleBits = 16;
+        m_headerParams = true;
+    }
+    else
+    {
+        m_sampleBits = (format == FormatS16 ? 16 : 8);
+    }
+
+    m_sampleBytes = ((format == FormatU8) || (format == FormatS8)) ? 1 : 2;
+
+    if ((m_sampleBits < 1) || (m_sampleBits > 8 * m_sampleBytes))
+    {
+        m_error = "Invalid number of bits per sample in header of " + filename;
+        closeFile();
+        return false;
+    }
+
+    m_data = m_map + headerSize;
+    m_nbSamples = (m_mapSize - headerSize) / (2 * m_sampleBytes);
+    m_sampleIndex = 0;
+    m_format = format;
+    m_devname = filename;
+
+    std::cerr << "ReplaySource::openFile: " << filename << ": " << m_nbSamples << " samples of "
+            << m_sampleBits << " bits" << std::endl;
+
+    return true;
+}
+
+void ReplaySource::closeFile()
+{
+    if (m_map)
+    {
+        munmap((void *) m_map, m_mapSize);
+        m_map = 0;
+        m_mapSize = 0;
+        m_data = 0;
+        m_nbSamples = 0;
+    }
+}
+
+// Return current sample frequency in Hz.
+uint32_t ReplaySource::get_sample_rate()
+{
+    return m_srate;
+}
+
+// Return device current center frequency in Hz.
+uint32_t ReplaySource::get_frequency()
+{
+    return m_freq;
+}
+
+void ReplaySource::print_specific_parms()
+{
+    std::cerr << "File:              " << m_filename << std::endl;
+    std::cerr << "Samples:           " << m_nbSamples << " of " << m_sampleBits << " bits" << std::endl;
+
+    if (m_speed > 0.0) {
+        std::cerr << "Speed:             " << m_speed << " x real time" << std::endl;
+    } else {
+        std::cerr << "Speed:             maximum" << std::endl;
+    }
+}
+
+bool ReplaySource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag)
+{
+    std::cerr << "ReplaySource::start" << std::endl;
+
+    m_buf = buf;
+    m_stop_flag = stop_flag;
+
+    if (m_nbSamples == 0)
+    {
+        m_error = "No file to replay (use file=<path>)";
+        return false;
+    }
+
+    if (m_thread == 0)
+    {
+        m_thread = new std::thread(run, this);
+        return true;
+    }
+    else
+    {
+        m_error = "Source thread already started";
+        return false;
+    }
+}
+
+bool ReplaySource::stop()
+{
+    std::cerr << "ReplaySource::stop" << std::endl;
+
+    if (m_thread)
+    {
+        m_thread->join();
+        delete m_thread;
+        m_thread = 0;
+    }
+
+    return true;
+}
+
+/**
+ * Push blocks until the end of file (unless looping) or until stopped. When
+ * paced each block is pushed at the time it would have been received from a
+ * device at the sample rate multiplied by speed. The pacing reference restarts
+ * when the sample rate or the speed changes. Unpaced blocks are pushed as soon
+ * as the processing thread makes room for them and none is dropped.
+ */
+void ReplaySource::run(ReplaySource *source)
+{
+    std::cerr << "ReplaySource::run" << std::endl;
+    ThreadConfig::apply("device");
+
+    IQSampleVector iqsamples;
+    void *msgBuf = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point paceStart = start;
+    uint64_t pacedSamples = 0;
+    uint64_t totalSamples = 0;
+    uint32_t srate = source->m_srate;
+    float speed = source->m_speed;
+    bool endOfFile = false;
+
+    while (!source->m_stop_flag->load())
+    {
+        if ((srate != source->m_srate) || (speed != source->m_speed))
+        {
+            srate = source->m_srate;
+            speed = source->m_speed;
+            paceStart = std::chrono::steady_clock::now();
+            pacedSamples = 0;
+        }
+
+        unsigned int normShift = source->get_norm_shift();
+
+        if (!source->get_samples(iqsamples, normShift))
+        {
+            endOfFile = true;
+            break;
+        }
+
+        pacedSamples += iqsamples.size();
+        totalSamples += iqsamples.size();
+        SampleStamp stamp = source->stamp_block(iqsamples.size(), normShift);
+
+        if (speed > 0.0)
+        {
+            source->m_buf->push(move(iqsamples), stamp);
+            std::chrono::duration<double> due(pacedSamples / (srate * (double) speed));
+            std::this_thread::sleep_until(paceStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+        }
+        else
+        {
+            source->push_waiting(move(iqsamples), stamp);
+        }
+
+        int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+
+        if ((len > 0) && msgBuf)
+        {
+            std::string msg((char *) msgBuf, len);
+            std::cerr << "ReplaySource::run: received: " << msg << std::endl;
+            source->DeviceSource::configure(msg);
+            nn_freemsg(msgBuf);
+            msgBuf = 0;
+        }
+    }
+
+    if (endOfFile)
+    {
+        std::cerr << "ReplaySource::run: end of file" << std::endl;
+        source->m_buf->push_end(); // end of stream makes the main loop exit
+    }
+
+    // Throughput of the daemon: time until the processing thread has taken the last block
+    uint64_t consumedSamples = source->wait_consumed(totalSamples);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "ReplaySource::run: %lu samples consumed in %.3f s (%.0f S/s)\n",
+            (unsigned long) consumedSamples, elapsed, elapsed > 0.0 ? consumedSamples / elapsed : 0.0);
+}
+
+// Convert next block of samples from the file.
+bool ReplaySource::get_samples(IQSampleVector& samples, unsigned int normShift)
+{
+    if (m_sampleIndex == m_nbSamples)
+    {
+        if (!m_loop) {
+            return false;
+        }
+
+        m_sampleIndex = 0;
+    }
+
+    std::size_t nbSamples = m_nbSamples - m_sampleIndex;
+    std::size_t blockLength = latency_samples(64, 64, m_block_length);
+
+    if (nbSamples > blockLength) {
+        nbSamples = blockLength;
+    }
+
+    const uint8_t *in = m_data + 2 * m_sampleBytes * m_sampleIndex;
+    samples = m_buf->get_block(nbSamples);
+
+    switch (m_format)
+    {
+    case FormatU8:
+        SampleConverter::convertU8(in, samples.data(), nbSamples, normShift);
+        break;
+    case FormatS8:
+        SampleConverter::convertS8((const int8_t *) in, samples.data(), nbSamples, normShift);
+        break;
+    default: // 16 bit little endian as in memory
+        memcpy((void *) samples.data(), (const void *) in, nbSamples * sizeof(IQSample));
+        break;
+    }
+
+    m_sampleIndex += nbSamples;
+    return true;
+}
+
+// Return a list of supported devices.
+void ReplaySource::get_device_names(std::vector<std::string>& devices)
+{
+    devices.clear();
+    devices.push_back("Replay of recorded I/Q file 0");
+}
+
+/* end */
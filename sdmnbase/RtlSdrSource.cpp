@@ -26,17 +26,25 @@
 
 #include "RtlSdrSource.h"
 #include "util.h"
+#include "ThreadConfig.h"
+#include "SampleConverter.h"
 #include "parsekv.h"
 
 #define RTLSDR_ASYNC_BUF_NUMBER 12
+#define RTLSDR_ASYNC_BUF_MAX    128
 #define RTLSDR_DATA_LEN         (16*16384)   /* 256k */
+#define RTLSDR_DATA_QUANTUM     512          /* one USB bulk packet */
 
-RtlSdrSource *RtlSdrSource::m_this = 0;
 
 // Open RTL-SDR device.
 RtlSdrSource::RtlSdrSource(int dev_index) :
     m_dev(0),
-    m_thread(0)
+    m_thread(0),
+    m_transferSamples(0),
+    m_nbTransfers(0),
+    m_restartAsync(false),
+    m_stopAsync(false),
+    m_readingAsync(false)
 {
     int r;
 
@@ -66,8 +74,6 @@ RtlSdrSource::RtlSdrSource(int dev_index) :
 
         m_gainsStr = gains_ostr.str();
     }
-
-    m_this = this;
 }
 
 
@@ -76,8 +82,6 @@ RtlSdrSource::~RtlSdrSource()
 {
     if (m_dev)
         rtlsdr_close(m_dev);
-
-    m_this = 0;
 }
 
 bool RtlSdrSource::configure(parsekv::pairs_type& m)
@@ -450,7 +454,7 @@ bool RtlSdrSource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag)
 
     if (m_thread == 0)
     {
-        m_thread = new std::thread(run);
+        m_thread = new std::thread(run, this);
         return true;
     }
     else
@@ -472,30 +476,62 @@ bool RtlSdrSource::stop()
     return true;
 }
 
-void RtlSdrSource::run()
+void RtlSdrSource::run(RtlSdrSource *source)
 {
+    ThreadConfig::apply("control");
     IQSampleVector iqsamples;
     void *msgBuf = 0;
 
-    std::thread *readerTrhead = new std::thread(readerThreadEntryPoint);
+    std::thread *readerTrhead = new std::thread(readerThreadEntryPoint, source);
 
-    while (!m_this->m_stop_flag->load())
+    while (!source->m_stop_flag->load())
     {
-        int len = nn_recv(m_this->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+        int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
 
         if ((len > 0) && msgBuf)
         {
             std::string msg((char *) msgBuf, len);
             std::cerr << "RtlSdrSource::run: received: " << msg << std::endl;
-            m_this->DeviceSource::configure(msg);
+            source->DeviceSource::configure(msg);
             nn_freemsg(msgBuf);
             msgBuf = 0;
+
+            // Transfers are sized when reading starts. Restart reading if the size changed.
+            std::uint32_t transferSamples = source->get_transfer_samples();
+
+            if ((transferSamples != source->m_transferSamples)
+             || (source->get_nb_transfers(transferSamples) != source->m_nbTransfers))
+            {
+                std::lock_guard<std::mutex> lock(source->m_asyncMutex);
+                source->m_restartAsync = true;
+                rtlsdr_cancel_async(source->m_dev);
+            }
         }
 
         usleep(200000);
     }
 
-    rtlsdr_cancel_async(m_this->m_dev);
+    {
+        std::lock_guard<std::mutex> lock(source->m_asyncMutex);
+        source->m_stopAsync = true;
+    }
+
+    // A cancel issued before rtlsdr_read_async is entered is ignored by the library
+    // so cancel until the reader thread is out of its reading loop.
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(source->m_asyncMutex);
+
+            if (!source->m_readingAsync) {
+                break;
+            }
+
+            rtlsdr_cancel_async(source->m_dev);
+        }
+
+        usleep(10000);
+    }
 
     readerTrhead->join();
     delete readerTrhead;
@@ -525,31 +561,74 @@ void RtlSdrSource::get_device_names(std::vector<std::string>& devices)
     }
 }
 
-void RtlSdrSource::readerThreadEntryPoint()
+void RtlSdrSource::readerThreadEntryPoint(RtlSdrSource *source)
 {
+    ThreadConfig::apply("device");
+
     // reset buffer to start streaming
-    if (rtlsdr_reset_buffer(m_this->m_dev) < 0)
+    if (rtlsdr_reset_buffer(source->m_dev) < 0)
     {
         std::cerr << "RtlSdrSource::readerThreadEntryPoint: rtlsdr_reset_buffer failed" << std::endl;
         return;
     }
 
-    rtlsdr_read_async(m_this->m_dev, rtlsdrCallback, 0,
-                          RTLSDR_ASYNC_BUF_NUMBER,
-                          RTLSDR_DATA_LEN);
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(source->m_asyncMutex);
+
+            if (source->m_stopAsync || source->m_stop_flag->load())
+            {
+                source->m_readingAsync = false;
+                break;
+            }
+
+            source->m_readingAsync = true;
+            source->m_restartAsync = false;
+        }
+
+        source->m_transferSamples = source->get_transfer_samples();
+        source->m_nbTransfers = source->get_nb_transfers(source->m_transferSamples);
+
+        std::cerr << "RtlSdrSource::readerThreadEntryPoint: " << source->m_nbTransfers << " transfers of "
+                << source->m_transferSamples << " samples" << std::endl;
+
+        rtlsdr_read_async(source->m_dev, rtlsdrCallback, (void *) source,
+                              source->m_nbTransfers,
+                              2 * source->m_transferSamples);
+
+        std::lock_guard<std::mutex> lock(source->m_asyncMutex);
+
+        if (!source->m_restartAsync)
+        {
+            source->m_readingAsync = false;
+            break;
+        }
+    }
 }
 
-void RtlSdrSource::rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx __attribute__((unused)))
+std::uint32_t RtlSdrSource::get_transfer_samples()
 {
-    IQSampleVector samples;
-    samples.resize(len/2);
+    return latency_samples(RTLSDR_DATA_QUANTUM / 2, RTLSDR_DATA_QUANTUM / 2, RTLSDR_DATA_LEN / 2);
+}
 
-    for (unsigned int i = 0; i < len/2; i++)
-    {
-        samples[i] = IQSample(buf[2*i] - 128, buf[2*i+1] - 128);
+std::uint32_t RtlSdrSource::get_nb_transfers(std::uint32_t transferSamples)
+{
+    if (get_latency_ms() == 0) {
+        return RTLSDR_ASYNC_BUF_NUMBER;
     }
 
-    m_this->m_buf->push(move(samples));
+    return latency_buffers(transferSamples, RTLSDR_ASYNC_BUF_NUMBER, RTLSDR_ASYNC_BUF_MAX);
+}
+
+void RtlSdrSource::rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx)
+{
+    RtlSdrSource *source = (RtlSdrSource *) ctx;
+    unsigned int normShift = source->get_norm_shift();
+    SampleStamp stamp = source->stamp_block(len/2, normShift);
+    IQSampleVector samples = source->m_buf->get_block(len/2);
+    SampleConverter::convertU8(buf, samples.data(), len/2, normShift);
+    source->m_buf->push(move(samples), stamp);
 }
 
 /* end */
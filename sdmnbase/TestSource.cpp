@@ -18,6 +18,8 @@
 
 #include <climits>
 #include <cstring>
+#include <chrono>
+#include <random>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -26,9 +28,9 @@
 
 #include "TestSource.h"
 #include "util.h"
+#include "ThreadConfig.h"
 #include "parsekv.h"
 
-TestSource *TestSource::m_this = 0;
 const uint32_t TestSource::m_sampleBits = 16;
 const uint32_t TestSource::m_sampleWidth = 1<<TestSource::m_sampleBits;
 const uint32_t TestSource::m_sampleHalfWidth = 1<<(TestSource::m_sampleBits-1);
@@ -39,21 +41,25 @@ TestSource::TestSource(int dev_index) :
     m_block_length(default_block_length),
     m_thread(0),
     m_carrierOffset(10000),
-	m_phase(0.0),
 	m_freq(435000000),
 	m_srate(64000),
-	m_amplitude(0.1)
+	m_amplitude(0.1),
+	m_nbTones(1),
+	m_toneStep(10000),
+	m_chirpPeriod(0),
+	m_noiseDb(40),
+	m_noise(false),
+	m_speed(1.0),
+	m_noiseState(2463534242U)
 {
-    m_this = this;
     m_confFreq = 435000000; // default frequency center position in Source.h is centered
-    m_deltaPhase = getDeltaPhase(m_carrierOffset, m_srate);
+    setup_oscillators();
 }
 
 
 // Close test device.
 TestSource::~TestSource()
 {
-    m_this = 0;
 }
 
 bool TestSource::configure(parsekv::pairs_type& m)
@@ -61,7 +67,6 @@ bool TestSource::configure(parsekv::pairs_type& m)
     uint32_t sample_rate = m_srate;
     uint32_t frequency = m_confFreq;
     int32_t carrierOffset = m_carrierOffset;
-    float deltaPhase = m_deltaPhase;
     float amplitude = 1.0;
     int block_length =  default_block_length;
     int fcpos = 2; // default is center
@@ -73,15 +78,13 @@ bool TestSource::configure(parsekv::pairs_type& m)
 		std::cerr << "TestSource::configure(m): srate: " << m["srate"] << std::endl;
 		sample_rate = atoi(m["srate"].c_str());
 
-		if ((sample_rate < 8000) || (sample_rate > 10000000))
+		if ((sample_rate < 8000) || (sample_rate > 100000000))
 		{
 			m_error = "Invalid sample rate";
 			return false;
 		}
 
-        deltaPhase = getDeltaPhase(carrierOffset, sample_rate);
-
-		changeFlags |= 0x5; // change delta phase and sample rate
+		changeFlags |= 0x1;
 
         if (m_fcPos != 2)
         {
@@ -106,17 +109,13 @@ bool TestSource::configure(parsekv::pairs_type& m)
 	if (m.find("dfp") != m.end())
 	{
 		std::cerr << "TestSource::configure(m): dfp: " << m["dfp"] << std::endl;
-		int32_t carrierOffset = atoi(m["dfp"].c_str());
+		carrierOffset = atoi(m["dfp"].c_str());
 
 		if ((carrierOffset > (int32_t) sample_rate/2) || (carrierOffset < 0))
 		{
 			m_error = "Invalid positive carrier offset";
 			return false;
 		}
-		else
-		{
-			deltaPhase = getDeltaPhase(carrierOffset, sample_rate);
-		}
 
 		dfp = true;
 		changeFlags |= 0x4;
@@ -125,17 +124,15 @@ bool TestSource::configure(parsekv::pairs_type& m)
 	if ((m.find("dfn") != m.end()) && !dfp)
 	{
 		std::cerr << "TestSource::configure(m): dfn: " << m["dfn"] << std::endl;
-		int32_t carrierOffset = atoi(m["dfn"].c_str());
+		carrierOffset = atoi(m["dfn"].c_str());
 
 		if ((carrierOffset > (int32_t) sample_rate/2) || (carrierOffset < 0))
 		{
 			m_error = "Invalid negative carrier offset";
 			return false;
 		}
-		else
-		{
-			deltaPhase = getDeltaPhase(-carrierOffset, sample_rate);
-		}
+
+		carrierOffset = -carrierOffset;
 
 		changeFlags |= 0x4;
 	}
@@ -165,6 +162,91 @@ bool TestSource::configure(parsekv::pairs_type& m)
 		changeFlags |= 0x20;
 	}
 
+	if (m.find("tones") != m.end())
+	{
+		std::cerr << "TestSource::configure(m): tones: " << m["tones"] << std::endl;
+		int nbTones = atoi(m["tones"].c_str());
+
+		if ((nbTones < 1) || (nbTones > (int) max_tones))
+		{
+			m_error = "Invalid number of tones";
+			return false;
+		}
+
+		m_nbTones = nbTones;
+		changeFlags |= 0x4;
+	}
+
+	if (m.find("tonestep") != m.end())
+	{
+		std::cerr << "TestSource::configure(m): tonestep: " << m["tonestep"] << std::endl;
+		int32_t toneStep = atoi(m["tonestep"].c_str());
+
+		if ((toneStep > (int32_t) sample_rate) || (toneStep < -(int32_t) sample_rate))
+		{
+			m_error = "Invalid tone step";
+			return false;
+		}
+
+		m_toneStep = toneStep;
+		changeFlags |= 0x4;
+	}
+
+	if (m.find("chirp") != m.end())
+	{
+		std::cerr << "TestSource::configure(m): chirp: " << m["chirp"] << std::endl;
+		int chirpPeriod = atoi(m["chirp"].c_str());
+
+		if (chirpPeriod < 0)
+		{
+			m_error = "Invalid chirp period";
+			return false;
+		}
+
+		m_chirpPeriod = chirpPeriod;
+		m_chirp.setPhase(0.0);
+		m_chirp.setFrequency(-(double) sample_rate / 2.0, sample_rate); // restart sweep at low edge
+		changeFlags |= 0x4;
+	}
+
+	if (m.find("noise") != m.end())
+	{
+		std::cerr << "TestSource::configure(m): noise: " << m["noise"] << std::endl;
+
+		if (m["noise"] == "off")
+		{
+			m_noise = false;
+		}
+		else
+		{
+			int dbn = atoi(m["noise"].c_str());
+
+			if (dbn < 0)
+			{
+				m_error = "Invalid noise power";
+				return false;
+			}
+
+			m_noiseDb = dbn;
+			m_noise = true;
+			setup_noise();
+		}
+	}
+
+	if (m.find("speed") != m.end())
+	{
+		std::cerr << "TestSource::configure(m): speed: " << m["speed"] << std::endl;
+		float speed = atof(m["speed"].c_str());
+
+		if (speed < 0.0)
+		{
+			m_error = "Invalid generation speed";
+			return false;
+		}
+
+		m_speed = speed;
+	}
+
 	if (m.find("fcpos") != m.end())
 	{
 		std::cerr << "TestSource::configure(m): fcpos: " << m["fcpos"] << std::endl;
@@ -211,7 +293,7 @@ bool TestSource::configure(parsekv::pairs_type& m)
 		tuner_freq = frequency;
 	}
 
-	return configure(changeFlags, sample_rate, tuner_freq, carrierOffset, deltaPhase, amplitude, block_length);
+	return configure(changeFlags, sample_rate, tuner_freq, carrierOffset, amplitude, block_length);
 }
 
 // Configure test generator.
@@ -219,7 +301,6 @@ bool TestSource::configure(std::uint32_t changeFlags,
 		std::uint32_t sample_rate,
 		std::uint32_t frequency,
         std::int32_t carrierOffset,
-		float deltaPhase,
         float amplitude,
         int block_length)
 {
@@ -235,7 +316,6 @@ bool TestSource::configure(std::uint32_t changeFlags,
 
     if (changeFlags & 0x4)
     {
-    	m_deltaPhase = deltaPhase;
         m_carrierOffset = carrierOffset;
     }
 
@@ -252,9 +332,43 @@ bool TestSource::configure(std::uint32_t changeFlags,
 						 block_length;
     }
 
+    if (changeFlags & 0x5) // sample rate or tones
+    {
+        setup_oscillators();
+    }
+
     return true;
 }
 
+void TestSource::setup_oscillators()
+{
+    m_tones.resize(m_nbTones);
+
+    for (unsigned int i = 0; i < m_nbTones; i++) {
+        m_tones[i].setFrequency(m_carrierOffset + (double) i * m_toneStep, m_srate);
+    }
+
+    if (m_chirpPeriod > 0)
+    {
+        // sweep the band from -srate/2 to srate/2 in the chirp period
+        double sweepRate = (double) m_srate / (m_chirpPeriod * 1e-3);
+        m_chirp.setFrequency(m_chirp.getFrequency(m_srate), m_srate, sweepRate);
+    }
+}
+
+void TestSource::setup_noise()
+{
+    std::mt19937 generator;
+    // noise power relative to full scale is shared between I and Q
+    std::normal_distribution<float> distribution(0.0, db2A(-m_noiseDb) * m_sampleHalfWidth / sqrt(2.0));
+
+    m_noiseTable.resize(noise_table_size);
+
+    for (unsigned int i = 0; i < noise_table_size; i++) {
+        m_noiseTable[i] = distribution(generator);
+    }
+}
+
 
 // Return current sample frequency in Hz.
 uint32_t TestSource::get_sample_rate()
@@ -270,8 +384,23 @@ uint32_t TestSource::get_frequency()
 
 void TestSource::print_specific_parms()
 {
-	std::cerr << "Delta phase:       " << m_deltaPhase << " radians" << std::endl;
+	std::cerr << "Carrier offset:    " << m_carrierOffset << " Hz" << std::endl;
+	std::cerr << "Tones:             " << m_nbTones << " spaced by " << m_toneStep << " Hz" << std::endl;
 	std::cerr << "Amplitude:         " << m_amplitude << std::endl;
+
+	if (m_chirpPeriod > 0) {
+		std::cerr << "Chirp period:      " << m_chirpPeriod << " ms" << std::endl;
+	}
+
+	if (m_noise) {
+		std::cerr << "Noise power:       " << -m_noiseDb << " dB" << std::endl;
+	}
+
+	if (m_speed > 0.0) {
+		std::cerr << "Speed:             " << m_speed << " x real time" << std::endl;
+	} else {
+		std::cerr << "Speed:             maximum" << std::endl;
+	}
 }
 
 bool TestSource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag)
@@ -283,7 +412,7 @@ bool TestSource::start(DataBuffer<IQSample>* buf, std::atomic_bool *stop_flag)
 
     if (m_thread == 0)
     {
-        m_thread = new std::thread(run);
+        m_thread = new std::thread(run, this);
         return true;
     }
     else
@@ -307,63 +436,144 @@ bool TestSource::stop()
     return true;
 }
 
-void TestSource::run()
+/**
+ * Pace the blocks against the steady clock so that the generation time does
+ * not add up to the block duration. The pacing reference restarts when the
+ * sample rate or the speed changes.
+ */
+void TestSource::run(TestSource *source)
 {
 	std::cerr << "TestSource::run" << std::endl;
+    ThreadConfig::apply("device");
 
     IQSampleVector iqsamples;
     void *msgBuf = 0;
-
-    while (!m_this->m_stop_flag->load() && get_samples(&iqsamples))
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point paceStart = start;
+    uint64_t pacedSamples = 0;
+    uint64_t totalSamples = 0;
+    uint32_t srate = source->m_srate;
+    float speed = source->m_speed;
+
+    while (!source->m_stop_flag->load() && get_samples(source, &iqsamples))
     {
-        m_this->m_buf->push(move(iqsamples));
+        if ((srate != source->m_srate) || (speed != source->m_speed))
+        {
+            srate = source->m_srate;
+            speed = source->m_speed;
+            paceStart = std::chrono::steady_clock::now();
+            pacedSamples = 0;
+        }
 
-        int len = nn_recv(m_this->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
+        pacedSamples += iqsamples.size();
+        totalSamples += iqsamples.size();
+        SampleStamp stamp = source->stamp_block(iqsamples.size());
+
+        if (speed > 0.0)
+        {
+            source->m_buf->push(move(iqsamples), stamp);
+            std::chrono::duration<double> due(pacedSamples / (srate * (double) speed));
+            std::this_thread::sleep_until(paceStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+        }
+        else
+        {
+            source->push_waiting(move(iqsamples), stamp);
+        }
+
+        int len = nn_recv(source->m_nnReceiver, &msgBuf, NN_MSG, NN_DONTWAIT);
 
         if ((len > 0) && msgBuf)
         {
             std::string msg((char *) msgBuf, len);
             std::cerr << "TestSource::run: received: " << msg << std::endl;
-            m_this->DeviceSource::configure(msg);
+            source->DeviceSource::configure(msg);
             nn_freemsg(msgBuf);
             msgBuf = 0;
         }
     }
+
+    uint64_t consumedSamples = source->wait_consumed(totalSamples);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "TestSource::run: %lu samples consumed in %.3f s (%.0f S/s)\n",
+            (unsigned long) consumedSamples, elapsed, elapsed > 0.0 ? consumedSamples / elapsed : 0.0);
 }
 
 // Fetch a bunch of samples from the device.
-bool TestSource::get_samples(IQSampleVector *samples)
+bool TestSource::get_samples(TestSource *source, IQSampleVector *samples)
 {
-    int r, n_read;
-
     if (!samples) {
         return false;
     }
 
-    std::vector<int16_t> buf(2 * m_this->m_block_length); // one sample for I, one sample for Q
+    int blockLength = source->latency_samples(64, 64, source->m_block_length);
+    *samples = source->m_buf->get_block(blockLength);
+    source->generate(samples->data(), blockLength);
 
-    r = read_samples(buf.data(), 4 * m_this->m_block_length, n_read, m_this->m_phase, m_this->m_srate, m_this->m_deltaPhase, m_this->m_amplitude);
+    return true;
+}
 
-    if (r < 0)
+void TestSource::generate(IQSample *samples, unsigned int nbSamples)
+{
+    if (m_re.size() < nbSamples)
     {
-        m_this->m_error = "TestSource::get_samples: read_samples failed";
-        return false;
+        m_re.resize(nbSamples);
+        m_im.resize(nbSamples);
     }
 
-    if (n_read != 4 * m_this-> m_block_length)
+    float *re = m_re.data();
+    float *im = m_im.data();
+    unsigned int nbSignals = m_nbTones + (m_chirpPeriod > 0 ? 1 : 0);
+    float amplitude = m_amplitude * m_sampleHalfWidth / nbSignals; // peak is the sum of the signals amplitudes
+
+    if (m_noise)
     {
-        m_this->m_error = "TestSource::get_samples: short read, samples lost";
-        return false;
+        // noise is read from the table at a random even offset for each block
+        unsigned int i = 0;
+
+        while (i < nbSamples)
+        {
+            m_noiseState ^= m_noiseState << 13;
+            m_noiseState ^= m_noiseState >> 17;
+            m_noiseState ^= m_noiseState << 5;
+            unsigned int offset = m_noiseState & (noise_table_size - 2);
+            unsigned int len = (noise_table_size - offset) / 2;
+            len = len < nbSamples - i ? len : nbSamples - i;
+            const float *noise = &m_noiseTable[offset];
+
+            for (unsigned int j = 0; j < len; j++)
+            {
+                re[i+j] = noise[2*j];
+                im[i+j] = noise[2*j+1];
+            }
+
+            i += len;
+        }
+    }
+    else
+    {
+        std::fill(re, re + nbSamples, 0.0f);
+        std::fill(im, im + nbSamples, 0.0f);
     }
 
-    samples->resize(m_this->m_block_length);
+    for (unsigned int i = 0; i < m_nbTones; i++) {
+        m_tones[i].add(re, im, nbSamples, amplitude);
+    }
 
-    for (int i = 0; i < m_this->m_block_length; i++)
-    {
-        (*samples)[i] = IQSample(buf[2*i], buf[2*i+1]);
+    if (m_chirpPeriod > 0) {
+        m_chirp.add(re, im, nbSamples, amplitude);
     }
 
-    return true;
+    int16_t *out = (int16_t *) samples;
+    const float max = m_sampleHalfWidth - 1;
+    const float min = -(float) m_sampleHalfWidth;
+
+    for (unsigned int i = 0; i < nbSamples; i++)
+    {
+        float r = re[i] < min ? min : re[i] > max ? max : re[i];
+        float q = im[i] < min ? min : im[i] > max ? max : im[i];
+        out[2*i]   = (int16_t) r;
+        out[2*i+1] = (int16_t) q;
+    }
 }
 
 
@@ -392,33 +602,4 @@ void TestSource::get_device_names(std::vector<std::string>& devices)
     }
 }
 
-int TestSource::read_samples(int16_t* data, int iqBlockSize, int& getSize, float& phasor, int sampleRate, float deltaPhase, float amplitude)
-{
-	int nbSamples = iqBlockSize / 4; // 16 bit samples
-	float dt = (float) nbSamples / (float) sampleRate;
-	int dtMicroseconds = (int) (dt * 1e6);
-
-	int i = 0;
-
-	for (; i < nbSamples * 2; i += 2)
-	{
-        data[i]   = amplitude * cos(phasor) * m_sampleHalfWidth;
-        data[i+1] = amplitude * sin(phasor) * m_sampleHalfWidth;
-
-		//phasor += 2.0 * M_PI * (1 / 20.0);
-		phasor += deltaPhase;
-
-		if (phasor > 2.0 * M_PI) {
-			phasor -= 2.0 * M_PI;
-		} else if (phasor < 2.0 * M_PI) {
-			phasor += 2.0 * M_PI;
-		}
-	}
-
-	usleep(dtMicroseconds);
-
-	getSize = i * 2;
-	return 0;
-}
-
 /* end */
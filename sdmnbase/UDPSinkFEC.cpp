@@ -23,31 +23,52 @@
 #include <boost/crc.hpp>
 #include <boost/cstdint.hpp>
 #include "UDPSinkFEC.h"
+#include "ThreadConfig.h"
 
 //#define SDRDAEMON_PUNCTURE 101 // debug: test FEC
 
-UDPSinkFEC::UDPSinkFEC(const std::string& address, unsigned int port) :
+UDPSinkFEC::UDPSinkFEC(const std::string& address, unsigned int port, unsigned int nbTxBlocks) :
     UDPSink::UDPSink(address, port, UDPSINKFEC_UDPSIZE),
     m_nbBlocksFEC(0),
+    m_txDelay(0),
+    m_nbTxBlocks(nbTxBlocks < 2 ? 2 : nbTxBlocks),
     m_txThread(0),
+    m_fecThread(0),
 	m_txBlockIndex(0),
 	m_txBlocksIndex(0),
 	m_frameCount(0),
-	m_sampleIndex(0)
+	m_sampleIndex(0),
+	m_samplesFramed(0),
+	m_blocksSent(0),
+	m_stampSamplesFramed(0),
+	m_frameLatency(-1),
+	m_txFramesQueued(0),
+	m_txFramesEncoded(0),
+	m_txFramesSent(0)
 {
+    m_txBlocks.resize(m_nbTxBlocks * 256);
+    m_txControlBlocks.resize(m_nbTxBlocks);
     m_cm256Valid = m_cm256.isInitialized();
     m_currentMetaFEC.init();
     m_udpSent.store(true);
     reset();
-    m_txThread = new std::thread(transmitUDP, this);
     m_running.store(true);
+    m_fecThread = new std::thread(encodeFEC, this);
+    m_txThread = new std::thread(transmitUDP, this);
 }
 
 UDPSinkFEC::~UDPSinkFEC()
 {
 	if (m_txThread)
 	{
+	    std::unique_lock<std::mutex> lock(m_txMutex);
 	    m_running.store(false);
+	    lock.unlock();
+	    m_txFrameReady.notify_all();
+	    m_txFrameEncoded.notify_all();
+	    m_txFrameFree.notify_all();
+		m_fecThread->join();
+		delete m_fecThread;
 		m_txThread->join();
 		delete m_txThread;
 	}
@@ -61,13 +82,21 @@ void UDPSinkFEC::setTxDelay(int txDelay)
 
 void UDPSinkFEC::reset()
 {
-    for (int i = 0; i < UDPSINKFEC_NBTXBLOCKS; i++)
+    std::unique_lock<std::mutex> lock(m_txMutex);
+
+    for (unsigned int i = 0; i < m_nbTxBlocks; i++)
     {
         m_txControlBlocks[i].m_processed = true;
     }
 
-    m_txIndexCurrent.store(0);
-    m_txIndexProcessing.store(0);
+    m_txFramesQueued = 0;
+    m_txFramesEncoded = 0;
+    m_txFramesSent = 0;
+
+    // framing restarts at the beginning of the first Tx row processed next
+    m_txBlocksIndex = 0;
+    m_txBlockIndex = 0;
+    m_sampleIndex = 0;
 }
 
 void UDPSinkFEC::setNbBlocksFEC(int nbBlocksFEC)
@@ -76,213 +105,264 @@ void UDPSinkFEC::setNbBlocksFEC(int nbBlocksFEC)
     m_nbBlocksFEC = nbBlocksFEC;
 }
 
+void UDPSinkFEC::setStamp(const SampleStamp& stamp)
+{
+    m_stamp = stamp;
+    m_stampSamplesFramed = m_samplesFramed.load();
+}
+
 void UDPSinkFEC::write(const IQSampleVector& samples_in)
 {
-	IQSampleVector::const_iterator it = samples_in.begin();
+    std::size_t inSamplesIndex = 0;
 	//std::cerr << "UDPSinkFEC::write: samples_in.size() = " << samples_in.size() << std::endl;
 
-	while (it != samples_in.end())
-	{
-        int inSamplesIndex = it - samples_in.begin();
-        int inRemainingSamples = samples_in.end() - it;
+    while (inSamplesIndex < samples_in.size())
+    {
+        unsigned int nbSamples;
+        IQSample *payload = getWriteSpan(nbSamples);
 
-	    if (m_txBlockIndex == 0) // Tx block index 0 is a block with only meta data
-	    {
-            struct timeval tv;
-            MetaDataFEC metaData;
+        if (nbSamples > samples_in.size() - inSamplesIndex) {
+            nbSamples = samples_in.size() - inSamplesIndex;
+        }
 
-            gettimeofday(&tv, 0);
+        memcpy((void *) payload, (const void *) &samples_in[inSamplesIndex], nbSamples * sizeof(IQSample));
+        commitWriteSpan(nbSamples);
+        inSamplesIndex += nbSamples;
+    }
+}
 
-            // create meta data TODO: semaphore
-            metaData.m_centerFrequency = m_centerFrequency;
-            metaData.m_sampleRate = m_sampleRate;
-            metaData.m_sampleBytes = m_sampleBytes;
-            metaData.m_sampleBits = m_sampleBits;
-            metaData.m_nbOriginalBlocks = UDPSINKFEC_NBORIGINALBLOCKS;
-            metaData.m_nbFECBlocks = m_nbBlocksFEC;
-            metaData.m_tv_sec = tv.tv_sec;
-            metaData.m_tv_usec = tv.tv_usec;
+IQSample *UDPSinkFEC::getWriteSpan(unsigned int& nbSamples)
+{
+    if (m_txBlockIndex == 0) // Tx block index 0 is a block with only meta data
+    {
+        writeMetaData();
+        m_txBlockIndex = 1; // next Tx block with data
+    }
 
-            boost::crc_32_type crc32;
-            crc32.process_bytes(&metaData, 20);
+    nbSamples = samplesPerBlock - m_sampleIndex;
+    return &txRow(m_txBlocksIndex)[m_txBlockIndex].protectedBlock.m_samples[m_sampleIndex];
+}
 
-            metaData.m_crc32 = crc32.checksum();
+void UDPSinkFEC::commitWriteSpan(unsigned int nbSamples)
+{
+    m_samplesFramed += nbSamples;
+    m_sampleIndex += nbSamples;
 
-            memset((void *) &m_superBlock, 0, UDPSINKFEC_UDPSIZE);
+    if (m_sampleIndex < samplesPerBlock) { // there is still room in the current super block
+        return;
+    }
 
-            m_superBlock.header.frameIndex = m_frameCount;
-            m_superBlock.header.blockIndex = m_txBlockIndex;
-            memcpy((void *) &m_superBlock.protectedBlock, (const void *) &metaData, sizeof(MetaDataFEC));
+    // complete super block and initiate the next if not end of frame
+    SuperBlock& superBlock = txRow(m_txBlocksIndex)[m_txBlockIndex];
+    superBlock.header.frameIndex = m_frameCount;
+    superBlock.header.blockIndex = m_txBlockIndex;
+    superBlock.header.filler = 0;
+    m_sampleIndex = 0;
 
-            if (!(metaData == m_currentMetaFEC))
-            {
-                std::cerr << "UDPSinkFEC::write: meta: "
-                        << "|" << metaData.m_centerFrequency
-                        << ":" << metaData.m_sampleRate
-                        << ":" << (int) (metaData.m_sampleBytes & 0xF)
-                        << ":" << (int) metaData.m_sampleBits
-                        << "|" << (int) metaData.m_nbOriginalBlocks
-                        << ":" << (int) metaData.m_nbFECBlocks
-                        << "|" << metaData.m_tv_sec
-                        << ":" << metaData.m_tv_usec
-                        << "|" << std::endl;
-
-                m_currentMetaFEC = metaData;
-            }
+    if (m_txBlockIndex == UDPSINKFEC_NBORIGINALBLOCKS - 1) // frame complete
+    {
+        m_txControlBlocks[m_txBlocksIndex].m_frameIndex = m_frameCount;
+        m_txControlBlocks[m_txBlocksIndex].m_processed = false;
+        m_txControlBlocks[m_txBlocksIndex].m_nbBlocksFEC = m_nbBlocksFEC;
+        m_txControlBlocks[m_txBlocksIndex].m_txDelay = m_txDelay;
 
-            m_txBlocks[m_txBlocksIndex][0] = m_superBlock;
-            m_txBlockIndex = 1; // next Tx block with data
-	    }
+        // Hand the frame to the FEC thread then wait until the next row is free
+        std::unique_lock<std::mutex> lock(m_txMutex);
+        m_txFramesQueued++;
+        m_txFrameReady.notify_one();
 
-        if (m_sampleIndex + inRemainingSamples < samplesPerBlock) // there is still room in the current super block
+        if ((m_txFramesQueued - m_txFramesSent == m_nbTxBlocks) && m_running.load())
         {
-            memcpy((void *) &m_superBlock.protectedBlock.m_samples[m_sampleIndex],
-                    (const void *) &samples_in[inSamplesIndex],
-                    inRemainingSamples * sizeof(IQSample));
-            m_sampleIndex += inRemainingSamples;
-            it = samples_in.end(); // all input samples are consumed
+            std::cerr << "UDPSinkFEC::write: warning: UDP transmit too slow" << std::endl;
+
+            while ((m_txFramesQueued - m_txFramesSent == m_nbTxBlocks) && m_running.load()) {
+                m_txFrameFree.wait(lock);
+            }
         }
-        else // complete super block and initiate the next if not end of frame
-        {
-            memcpy((void *) &m_superBlock.protectedBlock.m_samples[m_sampleIndex],
-                    (const void *) &samples_in[inSamplesIndex],
-                    (samplesPerBlock - m_sampleIndex) * sizeof(IQSample));
-            it += samplesPerBlock - m_sampleIndex;
-            m_sampleIndex = 0;
 
-            m_superBlock.header.frameIndex = m_frameCount;
-            m_superBlock.header.blockIndex = m_txBlockIndex;
-            m_txBlocks[m_txBlocksIndex][m_txBlockIndex] =  m_superBlock;
+        // the row follows the frame counter like the rows the FEC and send threads process
+        m_txBlocksIndex = m_txFramesQueued % m_nbTxBlocks;
+        lock.unlock();
 
-            if (m_txBlockIndex == UDPSINKFEC_NBORIGINALBLOCKS - 1) // frame complete
-            {
-                bool countsEqual = false;
-                m_txIndexCurrent.store(m_txBlocksIndex);
-                m_txControlBlocks[m_txBlocksIndex].m_frameIndex = m_frameCount;
-                m_txControlBlocks[m_txBlocksIndex].m_processed = false;
-                m_txControlBlocks[m_txBlocksIndex].m_nbBlocksFEC = m_nbBlocksFEC;
-                m_txControlBlocks[m_txBlocksIndex].m_txDelay = m_txDelay;
-
-//                m_txThread = new std::thread(transmitUDP, this, m_txBlocks[m_txBlocksIndex], m_frameCount, nbBlocksFEC, txDelay, m_cm256Valid);
-//                m_txThread = new std::thread(transmitUDP, this);
-
-                while ((((m_txBlocksIndex + 1) % UDPSINKFEC_NBTXBLOCKS) == m_txIndexProcessing.load())
-                    && m_running.load())
-                {
-                    if (!countsEqual)
-                    {
-                        std::cerr << "UDPSinkFEC::write: warning: UDP transmit too slow" << std::endl;
-                        countsEqual = true;
-                    }
+        m_txBlockIndex = 0;
+        m_frameCount++;
+    }
+    else
+    {
+        m_txBlockIndex++;
+    }
+}
 
-                    usleep(100);
-                }
+void UDPSinkFEC::writeMetaData()
+{
+    struct timeval tv;
+    MetaDataFEC metaData;
 
-                m_txBlocksIndex = (m_txBlocksIndex + 1) % UDPSINKFEC_NBTXBLOCKS;
-                m_txBlockIndex = 0;
-                m_frameCount++;
-            }
-            else
-            {
-                m_txBlockIndex++;
-            }
-        }
-	}
+    if (m_stamp.m_valid)
+    {
+        // acquisition time of the first sample of the frame
+        SampleStamp frameStamp = m_stamp.advance(m_samplesFramed.load() - m_stampSamplesFramed, m_sampleRate);
+        tv.tv_sec = frameStamp.m_realtime.tv_sec;
+        tv.tv_usec = frameStamp.m_realtime.tv_nsec / 1000;
+        m_frameLatency = (int64_t) (frameStamp.age() * 1e6);
+    }
+    else
+    {
+        gettimeofday(&tv, 0);
+    }
+
+    // create meta data TODO: semaphore
+    metaData.m_centerFrequency = m_centerFrequency;
+    metaData.m_sampleRate = m_sampleRate;
+    metaData.m_sampleBytes = m_sampleBytes;
+    metaData.m_sampleBits = m_sampleBits;
+    metaData.m_nbOriginalBlocks = UDPSINKFEC_NBORIGINALBLOCKS;
+    metaData.m_nbFECBlocks = m_nbBlocksFEC;
+    metaData.m_tv_sec = tv.tv_sec;
+    metaData.m_tv_usec = tv.tv_usec;
+
+    boost::crc_32_type crc32;
+    crc32.process_bytes(&metaData, 20);
+
+    metaData.m_crc32 = crc32.checksum();
+
+    SuperBlock& superBlock = txRow(m_txBlocksIndex)[0];
+    memset((void *) &superBlock, 0, UDPSINKFEC_UDPSIZE);
+
+    superBlock.header.frameIndex = m_frameCount;
+    superBlock.header.blockIndex = 0;
+    memcpy((void *) &superBlock.protectedBlock, (const void *) &metaData, sizeof(MetaDataFEC));
+
+    if (!(metaData == m_currentMetaFEC))
+    {
+        std::cerr << "UDPSinkFEC::write: meta: "
+                << "|" << metaData.m_centerFrequency
+                << ":" << metaData.m_sampleRate
+                << ":" << (int) (metaData.m_sampleBytes & 0xF)
+                << ":" << (int) metaData.m_sampleBits
+                << "|" << (int) metaData.m_nbOriginalBlocks
+                << ":" << (int) metaData.m_nbFECBlocks
+                << "|" << metaData.m_tv_sec
+                << ":" << metaData.m_tv_usec
+                << "|" << std::endl;
+
+        m_currentMetaFEC = metaData;
+    }
 }
 
-void UDPSinkFEC::transmitUDP(UDPSinkFEC *udpSinkFEC)
+void UDPSinkFEC::encodeFEC(UDPSinkFEC *udpSinkFEC)
 {
 	CM256::cm256_encoder_params cm256Params;  //!< Main interface with CM256 encoder
 	CM256::cm256_block descriptorBlocks[256]; //!< Pointers to data for CM256 encoder
-	ProtectedBlock fecBlocks[256];   //!< FEC data
     bool cm256Valid = udpSinkFEC->m_cm256Valid;
 
-//    std::cerr << "UDPSinkFEC::transmitUDP:"
-//            << " nbBlocksFEC: " << nbBlocksFEC
-//            << " txDelay: " << txDelay << std::endl;
+    ThreadConfig::apply("fec");
 
-	while (udpSinkFEC->m_running.load())
+	while (true)
 	{
-        int txIndexProcessing = udpSinkFEC->m_txIndexProcessing.load();
+        std::unique_lock<std::mutex> lock(udpSinkFEC->m_txMutex);
 
-        while ((udpSinkFEC->m_txIndexCurrent.load() == txIndexProcessing) && (udpSinkFEC->m_running.load()))
-        {
-            usleep(100);
+        while ((udpSinkFEC->m_txFramesEncoded == udpSinkFEC->m_txFramesQueued) && (udpSinkFEC->m_running.load())) {
+            udpSinkFEC->m_txFrameReady.wait(lock);
         }
 
-        uint16_t frameIndex = udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_frameIndex;
-        int nbBlocksFEC = udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_nbBlocksFEC;
-        int txDelay = udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_txDelay;
-        SuperBlock *txBlockx = udpSinkFEC->m_txBlocks[txIndexProcessing];
+        if (!udpSinkFEC->m_running.load()) {
+            break;
+        }
+
+        int txIndexProcessing = udpSinkFEC->m_txFramesEncoded % udpSinkFEC->m_nbTxBlocks;
+        lock.unlock();
 
-        if ((nbBlocksFEC == 0) || !cm256Valid)
+        TxControlBlock& txControlBlock = udpSinkFEC->m_txControlBlocks[txIndexProcessing];
+        SuperBlock *txBlockx = udpSinkFEC->txRow(txIndexProcessing);
+
+        if ((txControlBlock.m_nbBlocksFEC == 0) || !cm256Valid)
         {
-            for (int i = 0; i < UDPSINKFEC_NBORIGINALBLOCKS; i++)
-            {
-                udpSinkFEC->m_socket.SendDataGram((const void *) &txBlockx[i], (int) udpSinkFEC->m_udpSize, udpSinkFEC->m_address, udpSinkFEC->m_port);
-                usleep(txDelay);
-            }
+            txControlBlock.m_nbBlocksTx = UDPSINKFEC_NBORIGINALBLOCKS;
         }
         else
         {
             cm256Params.BlockBytes = sizeof(ProtectedBlock);
             cm256Params.OriginalCount = UDPSINKFEC_NBORIGINALBLOCKS;
-            cm256Params.RecoveryCount = nbBlocksFEC;
+            cm256Params.RecoveryCount = txControlBlock.m_nbBlocksFEC;
 
-            // Fill pointers to data
-            for (int i = 0; i < cm256Params.OriginalCount + cm256Params.RecoveryCount; ++i)
+            if ((cm256Params.RecoveryCount < 0) || (cm256Params.OriginalCount + cm256Params.RecoveryCount > 256))
+            {
+                std::cerr << "UDPSinkFEC::encodeFEC: CM256 encode failed. No transmission." << std::endl;
+                txControlBlock.m_nbBlocksTx = 0;
+            }
+            else
             {
-                if (i >= cm256Params.OriginalCount) {
-                    memset((void *) &txBlockx[i].protectedBlock, 0, sizeof(ProtectedBlock));
+                // Fill pointers to data
+                for (int i = 0; i < cm256Params.OriginalCount; ++i)
+                {
+                    txBlockx[i].header.frameIndex = txControlBlock.m_frameIndex;
+                    txBlockx[i].header.blockIndex = i;
+                    descriptorBlocks[i].Block = (void *) &(txBlockx[i].protectedBlock);
+                    descriptorBlocks[i].Index = txBlockx[i].header.blockIndex;
                 }
 
-                txBlockx[i].header.frameIndex = frameIndex;
-                txBlockx[i].header.blockIndex = i;
-                descriptorBlocks[i].Block = (void *) &(txBlockx[i].protectedBlock);
-                descriptorBlocks[i].Index = txBlockx[i].header.blockIndex;
-            }
+                // Encode FEC blocks directly in the payload of the blocks sent after the original ones
+                for (int i = cm256Params.OriginalCount; i < cm256Params.OriginalCount + cm256Params.RecoveryCount; ++i)
+                {
+                    txBlockx[i].header.frameIndex = txControlBlock.m_frameIndex;
+                    txBlockx[i].header.blockIndex = i;
+                    txBlockx[i].header.filler = 0;
+                    udpSinkFEC->m_cm256.cm256_encode_block(cm256Params, descriptorBlocks, i, (void *) &(txBlockx[i].protectedBlock));
+                }
 
-            // Encode FEC blocks
-            if (udpSinkFEC->m_cm256.cm256_encode(cm256Params, descriptorBlocks, fecBlocks))
-            {
-                std::cerr << "UDPSinkFEC::transmitUDP: CM256 encode failed. No transmission." << std::endl;
-                return;
+                txControlBlock.m_nbBlocksTx = cm256Params.OriginalCount + cm256Params.RecoveryCount;
             }
+        }
 
-            // Merge FEC with data to transmit
-            for (int i = 0; i < cm256Params.RecoveryCount; i++)
-            {
-                txBlockx[i + cm256Params.OriginalCount].protectedBlock = fecBlocks[i];
-            }
+        lock.lock();
+        udpSinkFEC->m_txFramesEncoded++;
+        lock.unlock();
+        udpSinkFEC->m_txFrameEncoded.notify_one();
+	}
+}
 
-            // Transmit all blocks
-            for (int i = 0; i < cm256Params.OriginalCount + cm256Params.RecoveryCount; i++)
-            {
-    #ifdef SDRDAEMON_PUNCTURE
-                if (i == SDRDAEMON_PUNCTURE) {
-                    continue;
-                }
-    #endif
-    //            std::cerr << "UDPSinkFEC::transmitUDP:"
-    //                  << " i: " << i
-    //                  << " frameIndex: " << (int) m_txBlocks[i].header.frameIndex
-    //                  << " blockIndex: " << (int) m_txBlocks[i].header.blockIndex
-    //                  << " i.q:";
-    //
-    //            for (int j = 0; j < 10; j++)
-    //            {
-    //                std::cerr << " " << (int) m_txBlocks[i].protectedBlock.m_samples[j].m_real
-    //                        << "." << (int) m_txBlocks[i].protectedBlock.m_samples[j].m_imag;
-    //            }
-    //
-    //            std::cerr << std::endl;
-
-                udpSinkFEC->m_socket.SendDataGram((const void *) &txBlockx[i], (int) udpSinkFEC->m_udpSize, udpSinkFEC->m_address, udpSinkFEC->m_port);
-                usleep(txDelay);
+void UDPSinkFEC::transmitUDP(UDPSinkFEC *udpSinkFEC)
+{
+    ThreadConfig::apply("send");
+
+	while (true)
+	{
+        std::unique_lock<std::mutex> lock(udpSinkFEC->m_txMutex);
+
+        while ((udpSinkFEC->m_txFramesSent == udpSinkFEC->m_txFramesEncoded) && (udpSinkFEC->m_running.load())) {
+            udpSinkFEC->m_txFrameEncoded.wait(lock);
+        }
+
+        if (!udpSinkFEC->m_running.load()) {
+            break;
+        }
+
+        int txIndexProcessing = udpSinkFEC->m_txFramesSent % udpSinkFEC->m_nbTxBlocks;
+        lock.unlock();
+
+        int nbBlocksTx = udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_nbBlocksTx;
+        int txDelay = udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_txDelay;
+        SuperBlock *txBlockx = udpSinkFEC->txRow(txIndexProcessing);
+
+        // Transmit all blocks
+        for (int i = 0; i < nbBlocksTx; i++)
+        {
+#ifdef SDRDAEMON_PUNCTURE
+            if (i == SDRDAEMON_PUNCTURE) {
+                continue;
             }
+#endif
+            udpSinkFEC->m_socket.SendDataGram((const void *) &txBlockx[i], (int) udpSinkFEC->m_udpSize, udpSinkFEC->m_address, udpSinkFEC->m_port);
+            usleep(txDelay);
         }
 
+        udpSinkFEC->m_blocksSent += nbBlocksTx;
         udpSinkFEC->m_txControlBlocks[txIndexProcessing].m_processed = true;
-        udpSinkFEC->m_txIndexProcessing.store((txIndexProcessing + 1) % UDPSINKFEC_NBTXBLOCKS);
+
+        lock.lock();
+        udpSinkFEC->m_txFramesSent++;
+        lock.unlock();
+        udpSinkFEC->m_txFrameFree.notify_one();
 	}
 }
@@ -0,0 +1,396 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+#include "SDRDaemon.h"
+#include "CpuFeatures.h"
+#include "SampleConverter.h"
+#include "IntHalfbandFilterBlock.h"
+#include "Decimators.h"
+#include "Interpolators.h"
+#include "Downsampler.h"
+#include "Channelizer.h"
+#include "WorkerPool.h"
+#include "parsekv.h"
+
+#define SDMNBENCH_BLOCK_SAMPLES 65536 // samples per block like a large device transfer
+
+static void badarg(const char *label);
+static bool parse_int(const char *s, int& v, bool allow_unit);
+
+void usage()
+{
+    fprintf(stderr,
+    "Usage: sdmnbench [options] mode\n"
+            "  mode           Stage to measure:\n"
+            "                   kernel       halfband decimation and interpolation by 2 to 64\n"
+            "                   resampler    halfband decimation with and without resampling to -o\n"
+            "                   channelizer  channelizer of -N channels and as many Downsampler chains with fshift\n"
+            "  -M level       Restrict the SIMD kernels to this level (see sdrdaemonrx -M)\n"
+            "  -s rate        Input sample rate in S/s (default 2400000 for resampler, 10000000 for channelizer)\n"
+            "  -b bits        Size of the input samples in bits (default 8)\n"
+            "  -d decim       resampler: log2 of the decimation (default 3)\n"
+            "  -o orate       resampler: output sample rate in S/s (default 48000)\n"
+            "  -N channels    channelizer: number of channels (default 16)\n"
+            "  -T threads     Threads sharing a block like dthreads (default 1)\n"
+            "  -t seconds     Duration of each measurement (default 1)\n"
+            "\n"
+            "Rates are given in input samples processed per second unless stated otherwise.\n"
+            "\n");
+}
+
+void badarg(const char *label)
+{
+    usage();
+    fprintf(stderr, "ERROR: Invalid argument for %s\n", label);
+    exit(1);
+}
+
+bool parse_int(const char *s, int& v, bool allow_unit=false)
+{
+    char *endp;
+    long t = strtol(s, &endp, 10);
+    if (endp == s)
+        return false;
+    if ( allow_unit && *endp == 'k' &&
+         t > INT_MIN / 1000 && t < INT_MAX / 1000 ) {
+        t *= 1000;
+        endp++;
+    }
+    if (*endp != '\0' || t < INT_MIN || t > INT_MAX)
+        return false;
+    v = t;
+    return true;
+}
+
+/** Random samples of sampleSize bits */
+static void make_samples(IQSampleVector& samples, unsigned int sampleSize)
+{
+    int range = 1 << sampleSize;
+
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        samples[i] = IQSample((rand() % range) - range/2, (rand() % range) - range/2);
+    }
+}
+
+/**
+ * Call process until seconds have elapsed, at least twice, the first call being
+ * a warm up. Return the number of samples per second given that each call
+ * processes nbSamples samples.
+ */
+static double measure(double seconds, std::size_t nbSamples, const std::function<void()>& process)
+{
+    process();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double elapsed;
+    unsigned long calls = 0;
+
+    do
+    {
+        process();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    while (elapsed < seconds);
+
+    return (calls * nbSamples) / elapsed;
+}
+
+static void bench_kernel(double seconds, unsigned int sampleSize)
+{
+    typedef void (Decimators::*Decimate)(unsigned int& sampleSize, const IQSample *in, std::size_t len, IQSampleVector& out);
+    typedef void (Interpolators::*Interpolate)(const IQSampleVector& in, IQSampleVector& out);
+    static const Decimate decimate[] = {
+        &Decimators::decimate2_cen, &Decimators::decimate4_cen, &Decimators::decimate8_cen,
+        &Decimators::decimate16_cen, &Decimators::decimate32_cen, &Decimators::decimate64_cen
+    };
+    static const Interpolate interpolate[] = {
+        &Interpolators::interpolate2_cen, &Interpolators::interpolate4_cen, &Interpolators::interpolate8_cen,
+        &Interpolators::interpolate16_cen, &Interpolators::interpolate32_cen, &Interpolators::interpolate64_cen
+    };
+
+    IQSampleVector in(SDMNBENCH_BLOCK_SAMPLES), out;
+    make_samples(in, sampleSize);
+
+    fprintf(stderr, "halfband kernels: %s, %s on 16 bits\n",
+            IntHalfbandFilterBlock<DECIMATORS_HB_FILTER_ORDER>::kernelName(),
+            IntHalfbandFilterBlock<DECIMATORS_HB_FILTER_ORDER>::kernel16Name());
+
+    for (unsigned int log2 = 1; log2 <= 6; log2++)
+    {
+        Decimators decimators;
+        double rate = measure(seconds, in.size(), [&]() {
+            unsigned int size = sampleSize;
+            (decimators.*decimate[log2 - 1])(size, in.data(), in.size(), out);
+        });
+
+        fprintf(stdout, "decimation by %2u of %2u bit samples: %8.2f MS/s\n", 1 << log2, sampleSize, rate / 1e6);
+    }
+
+    IQSampleVector interpIn(SDMNBENCH_BLOCK_SAMPLES / 64);
+    make_samples(interpIn, 16);
+
+    for (unsigned int log2 = 1; log2 <= 6; log2++)
+    {
+        Interpolators interpolators;
+        double rate = measure(seconds, interpIn.size() << log2, [&]() {
+            (interpolators.*interpolate[log2 - 1])(interpIn, out);
+        });
+
+        fprintf(stdout, "interpolation by %2u: %8.2f MS/s output\n", 1 << log2, rate / 1e6);
+    }
+}
+
+static bool configure(Downsampler& downsampler, parsekv::pairs_type config)
+{
+    if (!downsampler.configure(config))
+    {
+        fprintf(stderr, "ERROR: Downsampler configuration: %s\n", downsampler.error().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void bench_resampler(double seconds, unsigned int sampleSize, int rate, int decim, int orate, int nbThreads)
+{
+    Downsampler halfband, resampling;
+    IQSampleVector in(SDMNBENCH_BLOCK_SAMPLES), out;
+    make_samples(in, sampleSize);
+    parsekv::pairs_type config;
+    config["decim"] = std::to_string(decim);
+    config["dthreads"] = std::to_string(nbThreads);
+
+    halfband.setSampleRate(rate);
+    resampling.setSampleRate(rate);
+
+    if (!configure(halfband, config)) {
+        exit(1);
+    }
+
+    config["orate"] = std::to_string(orate);
+
+    if (!configure(resampling, config)) {
+        exit(1);
+    }
+
+    double hbRate = measure(seconds, in.size(), [&]() {
+        unsigned int size = sampleSize;
+        halfband.process(size, in, out);
+    });
+
+    fprintf(stdout, "halfband only to %u S/s:      %8.2f MS/s\n", halfband.getOutputSampleRate(), hbRate / 1e6);
+
+    double rsRate = measure(seconds, in.size(), [&]() {
+        unsigned int size = sampleSize;
+        resampling.process(size, in, out);
+    });
+
+    fprintf(stdout, "halfband and resampling to %u S/s: %8.2f MS/s\n", resampling.getOutputSampleRate(), rsRate / 1e6);
+}
+
+static void bench_channelizer(double seconds, unsigned int sampleSize, int rate, int nbChannels, int nbThreads)
+{
+    WorkerPool pool;
+    Channelizer channelizer;
+    IQSampleVector in(SDMNBENCH_BLOCK_SAMPLES);
+    std::vector<IQSampleVector> channels;
+    make_samples(in, sampleSize);
+
+    if (!channelizer.setNbChannels(nbChannels))
+    {
+        fprintf(stderr, "ERROR: %d channels not supported\n", nbChannels);
+        exit(1);
+    }
+
+    channelizer.setWorkerPool(&pool);
+    channelizer.setNbThreads(nbThreads);
+
+    double chRate = measure(seconds, in.size(), [&]() {
+        channelizer.process(in, channels);
+    });
+
+    fprintf(stdout, "channelizer of %d channels:     %8.2f MS/s\n", nbChannels, chRate / 1e6);
+
+    unsigned int decim = 0;
+
+    while ((1U << decim) < channelizer.getDecimation()) {
+        decim++;
+    }
+
+    if (decim > 6)
+    {
+        fprintf(stdout, "%d Downsampler chains: decimation by %u not supported\n", nbChannels, channelizer.getDecimation());
+        return;
+    }
+
+    // same output rate and channel centers as the channelizer
+    std::vector<Downsampler*> downsamplers(nbChannels);
+    IQSampleVector out;
+
+    parsekv::pairs_type config;
+    config["decim"] = std::to_string(decim);
+    config["fcpos"] = std::to_string((int) Downsampler::FC_POS_CENTER);
+    config["dthreads"] = std::to_string(nbThreads);
+
+    for (int k = 0; k < nbChannels; k++)
+    {
+        config["fshift"] = std::to_string((int) lrint(channelizer.getChannelFrequency(k) * rate));
+        downsamplers[k] = new Downsampler();
+        downsamplers[k]->setWorkerPool(&pool);
+        downsamplers[k]->setSampleRate(rate);
+
+        if (!configure(*downsamplers[k], config)) {
+            exit(1);
+        }
+    }
+
+    double dsRate = measure(seconds, in.size(), [&]() {
+        for (int k = 0; k < nbChannels; k++)
+        {
+            unsigned int size = sampleSize;
+            downsamplers[k]->process(size, in, out);
+        }
+    });
+
+    fprintf(stdout, "%d Downsampler chains with fshift: %8.2f MS/s\n", nbChannels, dsRate / 1e6);
+
+    for (int k = 0; k < nbChannels; k++) {
+        delete downsamplers[k];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rate = 0;
+    int sampleSize = 8;
+    int decim = 3;
+    int orate = 48000;
+    int nbChannels = 16;
+    int nbThreads = 1;
+    int seconds = 1;
+
+    fprintf(stderr, "sdmnbench - Measure the throughput of the SDRdaemon processing stages\n");
+
+    const struct option longopts[] = {
+        { "level",      1, NULL, 'M' },
+        { "srate",      1, NULL, 's' },
+        { "bits",       1, NULL, 'b' },
+        { "decim",      1, NULL, 'd' },
+        { "orate",      1, NULL, 'o' },
+        { "channels",   1, NULL, 'N' },
+        { "threads",    1, NULL, 'T' },
+        { "time",       1, NULL, 't' },
+        { NULL,         0, NULL, 0 } };
+
+    int c, longindex;
+
+    while ((c = getopt_long(argc, argv, "M:s:b:d:o:N:T:t:", longopts, &longindex)) >= 0)
+    {
+        switch (c)
+        {
+            case 'M':
+                if (!CpuFeatures::setLevel(optarg)) {
+                    fprintf(stderr, "ERROR: -M %s: unknown level or not supported by this CPU\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 's':
+                if (!parse_int(optarg, rate, true) || (rate <= 0)) {
+                    badarg("-s");
+                }
+                break;
+            case 'b':
+                if (!parse_int(optarg, sampleSize) || (sampleSize < 1) || (sampleSize > 16)) {
+                    badarg("-b");
+                }
+                break;
+            case 'd':
+                if (!parse_int(optarg, decim) || (decim < 0) || (decim > 6)) {
+                    badarg("-d");
+                }
+                break;
+            case 'o':
+                if (!parse_int(optarg, orate, true) || (orate <= 0)) {
+                    badarg("-o");
+                }
+                break;
+            case 'N':
+                if (!parse_int(optarg, nbChannels)) {
+                    badarg("-N");
+                }
+                break;
+            case 'T':
+                if (!parse_int(optarg, nbThreads) || (nbThreads < 1)) {
+                    badarg("-T");
+                }
+                break;
+            case 't':
+                if (!parse_int(optarg, seconds) || (seconds < 1)) {
+                    badarg("-t");
+                }
+                break;
+            default:
+                usage();
+                fprintf(stderr, "ERROR: Invalid command line options\n");
+                exit(1);
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage();
+        fprintf(stderr, "ERROR: Missing or unexpected mode\n");
+        exit(1);
+    }
+
+    std::string mode(argv[optind]);
+    fprintf(stderr, "sample conversion kernel: %s\n", SampleConverter::kernelName());
+
+    if (mode == "kernel")
+    {
+        bench_kernel(seconds, sampleSize);
+    }
+    else if (mode == "resampler")
+    {
+        bench_resampler(seconds, sampleSize, rate ? rate : 2400000, decim, orate, nbThreads);
+    }
+    else if (mode == "channelizer")
+    {
+        bench_channelizer(seconds, sampleSize, rate ? rate : 10000000, nbChannels, nbThreads);
+    }
+    else
+    {
+        usage();
+        fprintf(stderr, "ERROR: Unknown mode %s\n", mode.c_str());
+        exit(1);
+    }
+
+    return 0;
+}
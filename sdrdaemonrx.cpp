@@ -24,12 +24,15 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cctype>
 #include <climits>
 #include <cmath>
 #include <csignal>
 #include <cstring>
+#include <ctime>
 #include <algorithm>
 #include <atomic>
+#include <map>
 #include <memory>
 #include <thread>
 #include <unistd.h>
@@ -38,7 +41,14 @@
 
 #include "util.h"
 #include "DataBuffer.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
+#include "WorkerPool.h"
 #include "Downsampler.h"
+#include "Channelizer.h"
+#include "IntHalfbandFilterBlock.h"
+#include "SampleConverter.h"
+#include "CpuFeatures.h"
 #include "UDPSinkFEC.h"
 
 #ifdef HAS_RTLSDR
@@ -54,6 +64,7 @@
     #include "BladeRFSource.h"
 #endif
 #include "TestSource.h"
+#include "ReplaySource.h"
 #include "SDRDaemon.h"
 
 //#include <type_traits>
@@ -63,6 +74,61 @@
 /** Flag is set on SIGINT / SIGTERM. */
 static std::atomic_bool stop_flag(false);
 
+/** Number of devices still streaming. */
+static std::atomic_uint running_channels(0);
+
+
+/** Cumulated counts of the Rx pipeline stages at the time of the last report. */
+struct PipelineStats
+{
+    PipelineStats() : convertSamples(0), decimateSamples(0), frameSamples(0), fecFrames(0), sentBlocks(0)
+    {
+        gettimeofday(&tv, 0);
+    }
+
+    uint64_t       convertSamples;  //!< samples queued by the device thread
+    uint64_t       decimateSamples; //!< samples output by the decimation stage
+    uint64_t       frameSamples;    //!< samples framed into UDP blocks
+    uint64_t       fecFrames;       //!< frames FEC encoded
+    uint64_t       sentBlocks;      //!< UDP blocks sent
+    struct timeval tv;
+};
+
+/** Print throughput of each stage since last report and queue levels. */
+void report_pipeline_stats(const std::string& name,
+        PipelineStats& last,
+        uint64_t decimateSamples,
+        DataBuffer<IQSample>& source_buffer,
+        DataBuffer<IQSample>& output_buffer,
+        UDPSinkFEC *udp_output)
+{
+    PipelineStats current;
+    current.convertSamples = source_buffer.pushed_samples();
+    current.decimateSamples = decimateSamples;
+    current.frameSamples = udp_output->getSamplesFramed();
+    current.fecFrames = udp_output->getFramesEncoded();
+    current.sentBlocks = udp_output->getBlocksSent();
+
+    double dt = (current.tv.tv_sec - last.tv.tv_sec) + (current.tv.tv_usec - last.tv.tv_usec) * 1e-6;
+
+    if (dt > 0)
+    {
+        fprintf(stderr, "%sStats: convert %.0f S/s, decimate %.0f S/s, frame %.0f S/s, fec %.1f frames/s, send %.0f blocks/s"
+                " | queued: source %lu S, output %lu S, frames %u | latency %.1f ms\n",
+                name.c_str(),
+                (current.convertSamples - last.convertSamples) / dt,
+                (current.decimateSamples - last.decimateSamples) / dt,
+                (current.frameSamples - last.frameSamples) / dt,
+                (current.fecFrames - last.fecFrames) / dt,
+                (current.sentBlocks - last.sentBlocks) / dt,
+                source_buffer.queued_samples(),
+                output_buffer.queued_samples(),
+                udp_output->getFramesPending(),
+                udp_output->getFrameLatency() * 1e-3);
+    }
+
+    last = current;
+}
 
 /** Simple linear gain adjustment. */
 void adjust_gain(SampleVector& samples, double gain)
@@ -73,7 +139,9 @@ void adjust_gain(SampleVector& samples, double gain)
 }
 
 /**
- * Get data from output buffer and write to output stream.
+ * Get data from output buffer and write to output stream until the end marker
+ * pushed by the processing thread. The stop flag is not polled so that the
+ * processing thread is never left waiting for room in a full buffer.
  *
  * This code runs in a separate thread.
  */
@@ -81,7 +149,9 @@ void write_output_data(UDPSink *output,
         DataBuffer<IQSample> *buf,
         std::size_t buf_minfill)
 {
-    while (!stop_flag.load())
+    ThreadConfig::apply("output");
+
+    while (true)
     {
         if (buf->queued_samples() == 0)
         {
@@ -99,8 +169,12 @@ void write_output_data(UDPSink *output,
         }
 
         // Get samples from buffer and write to output.
-        IQSampleVector samples = buf->pull();
+        IQSampleVector samples;
+        SampleStamp stamp;
+        buf->pull(samples, stamp);
+        output->setStamp(stamp);
         output->write(samples);
+        buf->recycle(move(samples));
 
         if (!(*output))
         {
@@ -132,7 +206,8 @@ void usage()
 {
     fprintf(stderr,
     "Usage: sdrdaemonrx [options]\n"
-            "  -t devtype     Device type:\n"
+            "  -t devtype     Device type. May be repeated to serve several devices from one process.\n"
+            "                 Options -c, -d, -I, -D and -C that follow apply to this device:\n"
 #ifdef HAS_RTLSDR
             "                   - rtlsdr:  RTL-SDR devices\n"
 #endif
@@ -145,15 +220,36 @@ void usage()
 #ifdef HAS_BLADERF
             "                   - bladerf: BladeRF\n"
 #endif
-            "                   - test:    Test signal generator (CW carrier)\n"
+            "                   - test:    Test signal generator (tones, chirp and noise)\n"
+            "                   - replay:  Replay of a recorded I/Q file\n"
             "  -c config      Startup configuration. Comma separated key=value configuration pairs\n"
             "                 or just key for switches. See below for valid values\n"
             "  -d devidx      Device index, 'list' to show device list (default 0)\n"
             "  -b blocks      Set buffer size in number of UDP blocks (default: 480 512 samples blocks)\n"
-            "  -I address     IP address. Samples are sent to this address (default: 127.0.0.1)\n"
-            "  -D port        Data port. Samples are sent on this UDP port (default 9090)\n"
-            "  -C port        Configuration port (default 9091). The configuration string as described below\n"
-            "                 is sent on this port via nanomsg in TCP to control the device\n"
+            "  -I address     IP address. Samples are sent to this address\n"
+            "                 (default: the one of the previous device, 127.0.0.1 for the first one)\n"
+            "  -D port        Data port. Samples are sent on this UDP port (default 9090 + 2 x device number)\n"
+            "  -C port        Configuration port (default 9091 + 2 x device number). The configuration string\n"
+            "                 as described below is sent on this port via nanomsg in TCP to control the device\n"
+            "  -N channels    Split the band after decimation in this number of channels of equal width with a\n"
+            "                 polyphase filter bank (power of two from 2 to 256, default 0: whole band). Channels are\n"
+            "                 sent in increasing frequency order to the data port and the next ones, each with its\n"
+            "                 own meta data. Give the data ports of the next devices so that they do not overlap\n"
+            "  -r slots       Use a lock-free ring of this number of blocks between the device and the\n"
+            "                 processing thread instead of the default unbounded queue (default 0: queue)\n"
+            "  -q samples     Maximum number of samples queued between the device and the processing\n"
+            "                 thread (default 0: unbounded)\n"
+            "  -P policy      What to do when this maximum is reached (default oldest):\n"
+            "                   - block:   device thread waits\n"
+            "                   - newest:  incoming block is dropped\n"
+            "                   - oldest:  oldest queued blocks are dropped (incoming block with -r)\n"
+            "  -F frames      Number of FEC frames that can be queued for UDP transmission (default 8, minimum 2)\n"
+            "  -S seconds     Report throughput of each processing stage every this number of seconds (default 0: off)\n"
+            "  -A spec        Thread settings role:cpus[:policy[:priority]]. May be repeated. Roles are:\n"
+            "                 main, decim, device, control, output, fec, send. cpus is a list like 0,2-3 (may be empty),\n"
+            "                 policy is other, fifo or rr. Example: -A device:1:fifo:50\n"
+            "  -M level       Restrict SIMD kernels to this instruction set level to compare performance:\n"
+            "                 generic, sse2, sse4.1, avx2, avx512 on x86, generic, neon on ARM (default auto: best)\n"
             "\n"
             "Configuration options for the UDP sender:\n"
             "  txwait=<int>   Wait this number of microseconds (usleep) between transmission of each UDP packet (default 200)\n"
@@ -164,10 +260,19 @@ void usage()
             "                   - 0: Infradyne\n"
             "                   - 1: Supradyne\n"
             "                   - 2: Centered\n"
+            "  dthreads=<int> Number of threads sharing the decimation of each block (1..16, default 1)\n"
+            "                 Threads are shared by all the devices of the process\n"
             "\n"
             "Configuration options for the Forward Erasure Correction:\n"
             "  fecblk=<int>   Number of additional FEC blocks (1..128, default 32)\n"
             "\n"
+            "Configuration options for the device transfers:\n"
+            "  latency_ms=<int> Duration of samples in each transfer from the device in ms. Transfer size and\n"
+            "                 number of transfers in flight follow the sample rate. Transfers are never larger\n"
+            "                 than the device defaults which are kept with 0 (0..10000, default 0)\n"
+            "                 RTL-SDR, test and replay apply it at once, BladeRF when streaming starts.\n"
+            "                 HackRF and Airspy transfer sizes are fixed by their libraries.\n"
+            "\n"
 #ifdef HAS_RTLSDR
             "Configuration options for RTL-SDR devices\n"
             "  freq=<int>     Center frequency of operation in Hz (default 100000000)\n"
@@ -223,14 +328,39 @@ void usage()
             "  lgain=<int>    LNA gain in dB. 'list' to just get a list of valid values: (default 3)\n"
             "  v1gain=<int>   VGA1 gain in dB. 'list' to just get a list of valid values: (default 20)\n"
             "  v2gain=<int>   VGA2 gain in dB. 'list' to just get a list of valid values: (default 9)\n"
+            "  blklen=<int>   Number of samples per block read from the device (default 16384)\n"
+            "  nbufs=<int>    Number of libbladeRF stream buffers (default 64)\n"
+            "  bufsize=<int>  Samples per stream buffer, multiple of 1024 (default 8192)\n"
+            "  nxfers=<int>   Number of USB transfers in flight, less than nbufs (default 32)\n"
+            "  stimeout=<int> Stream timeout in ms (default 10000)\n"
             "\n"
 #endif
             "Configuration options for the test signal generator\n"
             "  freq=<int>     Center frequency sent in meta data in Hz. Valid values 10k to 10G (default 435000000)\n"
-            "  srate=<int>    Sample rate sent in meta data in Hz. Valid values: 8k to 10M (default 5000000)\n"
+            "  srate=<int>    Sample rate sent in meta data in Hz. Valid values: 8k to 100M (default 5000000)\n"
             "  dfp=<int>      Positive shift frequency of carrier from center frequency in Hz (default 100000)\n"
             "  dfn=<int>      Negative shift frequency of carrier from center frequency in Hz (default 100000)\n"
             "  power=<int>    Signal peak power in negative dB. (default 0)\n"
+            "  tones=<int>    Number of tones (1..16, default 1)\n"
+            "  tonestep=<int> Frequency step between successive tones from the first one in Hz (default 10000)\n"
+            "  chirp=<int>    Add a chirp sweeping the band in this number of ms. 0 for no chirp (default 0)\n"
+            "  noise=<int>    Add Gaussian noise of this power in negative dB, 'off' for no noise (default off)\n"
+            "  speed=<float>  Generation speed relative to real time. 0 for as fast as possible (default 1)\n"
+            "  blklen=<int>   Number of samples per block (default 65536)\n"
+            "\n"
+            "Configuration options for the replay source\n"
+            "  file=<path>    I/Q file to replay (mandatory)\n"
+            "  format=<str>   File format unless the file has a SDMNIQ header (default u8):\n"
+            "                   - u8:    unsigned 8 bit I/Q (rtl_sdr)\n"
+            "                   - s8:    signed 8 bit I/Q (hackrf_transfer)\n"
+            "                   - s16:   signed 16 bit little endian I/Q\n"
+            "                   - sdriq: sdrdaemontx file sink format\n"
+            "  bits=<int>     Effective bits per sample of s16 files (default 16)\n"
+            "  srate=<int>    Sample rate of the recording in Hz (default 1000000 or file header)\n"
+            "  freq=<int>     Center frequency of the recording in Hz (default 435000000 or file header)\n"
+            "  speed=<float>  Replay speed relative to real time. 0 for as fast as possible (default 1)\n"
+            "  loop           Restart at beginning of file when the end is reached\n"
+            "  blklen=<int>   Number of samples per block (default 65536)\n"
             "\n");
 }
 
@@ -261,7 +391,8 @@ bool parse_int(const char *s, int& v, bool allow_unit=false)
 }
 
 
-static bool get_device(std::vector<std::string> &devnames, std::string& devtype, DeviceSource **srcsdr, int devidx)
+/** List the devices of a type, return false if the type is not supported */
+static bool list_devices(std::vector<std::string> &devnames, const std::string& devtype)
 {
     bool deviceDefined = false;
 #ifdef HAS_RTLSDR
@@ -297,6 +428,11 @@ static bool get_device(std::vector<std::string> &devnames, std::string& devtype,
         TestSource::get_device_names(devnames);
         deviceDefined = true;
     }
+    if (strcasecmp(devtype.c_str(), "replay") == 0)
+    {
+        ReplaySource::get_device_names(devnames);
+        deviceDefined = true;
+    }
 
     if (!deviceDefined)
     {
@@ -314,9 +450,16 @@ static bool get_device(std::vector<std::string> &devnames, std::string& devtype,
         fprintf(stderr, "       bladerf\n");
 #endif
         fprintf(stderr, "       test\n");
+        fprintf(stderr, "       replay\n");
         return false;
     }
 
+    return true;
+}
+
+/** Open device devidx of a list returned by list_devices */
+static bool get_device(const std::vector<std::string> &devnames, const std::string& devtype, DeviceSource **srcsdr, int devidx)
+{
     if (devidx < 0 || (unsigned int)devidx >= devnames.size())
     {
         if (devidx != -1)
@@ -369,27 +512,292 @@ static bool get_device(std::vector<std::string> &devnames, std::string& devtype,
         // Open test device.
         *srcsdr = new TestSource(0);
     }
+    if (strcasecmp(devtype.c_str(), "replay") == 0)
+    {
+        // Open replay device.
+        *srcsdr = new ReplaySource(0);
+    }
 
     return true;
 }
+/** Settings and processing pipeline of one device. */
+struct RxChannel
+{
+    RxChannel() : devidx(0), dataport(-1), cfgport(-1), nbchannels(0) {}
+
+    std::string devtype;
+    std::string config;
+    int         devidx;
+    std::string dataaddress;
+    int         dataport;    //!< -1 for default
+    int         cfgport;     //!< -1 for default
+    unsigned int nbchannels; //!< number of channelizer outputs, 0 to send the whole band
+    std::string name;        //!< prefix of the messages about this device
+    std::unique_ptr<DeviceSource>         source;
+    std::unique_ptr<UDPSinkFEC>           udp_output;
+    std::vector<std::unique_ptr<UDPSinkFEC>> channel_outputs; //!< channelizer outputs after the first one sent by udp_output
+    std::unique_ptr<DataBuffer<IQSample>> source_buffer;
+    BufferPool<IQSample>                  source_pool;   //!< device blocks, not shared with other devices
+    DataBuffer<IQSample>                  output_buffer;
+    Downsampler                           downsampler;
+    Channelizer                           channelizer;
+    std::thread                           thread;        //!< processing thread
+    std::thread                           output_thread; //!< buffered output thread
+};
+
+/** Return the channel the device specific options apply to */
+static RxChannel *current_channel(std::vector<std::unique_ptr<RxChannel>>& channels)
+{
+    if (channels.empty()) {
+        channels.push_back(std::unique_ptr<RxChannel>(new RxChannel()));
+    }
+
+    return channels.back().get();
+}
+
+/**
+ * Split decimated samples in the channels of the channelizer and send each channel
+ * to its UDP output with its own center frequency and sample rate.
+ */
+void write_channels(RxChannel *channel,
+        const std::vector<UDPSinkFEC*>& outputs,
+        const IQSampleVector& samples,
+        std::vector<IQSampleVector>& channel_samples,
+        unsigned int sampleSize,
+        const SampleStamp& stamp,
+        bool send)
+{
+    Channelizer& channelizer = channel->channelizer;
+    uint32_t rate = channel->downsampler.getOutputSampleRate();
+    int64_t frequency = channel->source->get_received_frequency() + (int64_t) channel->downsampler.getFrequencyShift();
+
+    channelizer.setNbThreads(channel->downsampler.getNbThreads());
+    channelizer.process(samples, channel_samples);
+
+    if (!send) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < outputs.size(); i++)
+    {
+        outputs[i]->setCenterFrequency(frequency + (int64_t) llround(channelizer.getChannelFrequency(i) * rate));
+        outputs[i]->setSampleBits(sampleSize);
+        outputs[i]->setSampleBytes((sampleSize -1)/8 + 1);
+        outputs[i]->setSampleRate(rate / channelizer.getDecimation());
+        outputs[i]->setStamp(stamp);
+        outputs[i]->write(channel_samples[i]);
+    }
+}
+
+/**
+ * Decimate samples of a device and send them to its UDP output, or to the UDP
+ * outputs of its channels, until stopped or the end of stream is reached.
+ *
+ * This code runs in a separate thread for each device.
+ */
+void process_channel(RxChannel *channel, unsigned int outputbuf_samples, int stats_period)
+{
+    DeviceSource *source = channel->source.get();
+    UDPSinkFEC *udp_output = channel->udp_output.get();
+    DataBuffer<IQSample>& source_buffer = *channel->source_buffer;
+    DataBuffer<IQSample>& output_buffer = channel->output_buffer;
+    Downsampler& downsampler = channel->downsampler;
+    double ifrate = source->get_sample_rate();
+    unsigned int nbFECBlocks = 0;
+    unsigned int txDelay = 0;
+    IQSampleVector outsamples;
+    std::vector<IQSampleVector> channel_samples;
+    std::vector<UDPSinkFEC*> outputs(1, udp_output); // all outputs for the FEC and delay settings
+    bool channelize = (channel->nbchannels > 0);
+    bool inbuf_length_warning = false;
+    std::size_t dropped_reported = 0;
+    time_t dropped_report_time = 0;
+    uint64_t decimated_samples = 0;
+    PipelineStats last_stats;
+    time_t stats_report_time = time(0);
+
+    for (unsigned int i = 0; i < channel->channel_outputs.size(); i++) {
+        outputs.push_back(channel->channel_outputs[i].get());
+    }
+
+    ThreadConfig::apply("main");
+
+    // Processing loop.
+    for (unsigned int block = 0; !stop_flag.load(); block++)
+    {
+
+        // Check for overflow of source buffer.
+        if (!inbuf_length_warning && source_buffer.queued_samples() > 10 * ifrate)
+        {
+            fprintf(stderr, "\n%sWARNING: Input buffer is growing (system too slow)\n", channel->name.c_str());
+            inbuf_length_warning = true;
+        }
+
+        // Report samples dropped on source buffer overflow at most once per second.
+        std::size_t dropped = source_buffer.dropped_samples();
+
+        if ((dropped != dropped_reported) && (time(0) != dropped_report_time))
+        {
+            fprintf(stderr, "%sWARNING: Input buffer overflow: %lu samples in %lu blocks dropped\n",
+                    channel->name.c_str(), dropped, source_buffer.dropped_vectors());
+            dropped_reported = dropped;
+            dropped_report_time = time(0);
+        }
+
+        // Periodic throughput report of each stage.
+        if ((stats_period > 0) && (time(0) - stats_report_time >= stats_period))
+        {
+            report_pipeline_stats(channel->name, last_stats, decimated_samples, source_buffer, output_buffer, udp_output);
+            stats_report_time = time(0);
+        }
+
+        // Pull next block from source buffer.
+        IQSampleVector iqsamples;
+        SampleStamp stamp;
+        source_buffer.pull(iqsamples, stamp);
+
+        if (iqsamples.empty())
+        {
+            break;
+        }
+
+        udp_output->setCenterFrequency(source->get_received_frequency() + (int64_t) downsampler.getFrequencyShift());
+
+        unsigned int confNbFECBlocks = source->get_nb_fec_blocks();
+
+        if (confNbFECBlocks != nbFECBlocks)
+        {
+            nbFECBlocks = confNbFECBlocks;
+
+            for (unsigned int i = 0; i < outputs.size(); i++) {
+                outputs[i]->setNbBlocksFEC(nbFECBlocks);
+            }
+        }
+
+        unsigned int confTxDelay = source->get_tx_delay();
+
+        if (confTxDelay != txDelay)
+        {
+            txDelay = confTxDelay;
+
+            for (unsigned int i = 0; i < outputs.size(); i++) {
+                outputs[i]->setTxDelay(txDelay);
+            }
+        }
+
+        // Possible downsampling and write to UDP
+        // The device conversion may have normalized the block already (see set_normalize).
+        // The shift it applied comes with the block so that blocks queued before a change
+        // of decimation are scaled right.
+        bool rescale_only = (downsampler.getLog2Decimation() == 0) && !downsampler.isResampling() && !channelize;
+
+        if (rescale_only)
+        {
+            // nothing left to rescale if already normalized by the device
+            unsigned int sampleSize = source->get_sample_bits() + stamp.m_normShift;
+
+            udp_output->setSampleBits(source->get_sample_bits());
+            udp_output->setSampleBytes((source->get_sample_bits()-1)/8 + 1);
+            udp_output->setSampleRate(source->get_sample_rate());
+            decimated_samples += iqsamples.size();
+
+            if (outputbuf_samples > 0)
+            {
+                // Buffered write.
+                downsampler.rescale(sampleSize, iqsamples);
+                output_buffer.push(move(iqsamples), stamp);
+            }
+            else
+            {
+                // Direct write. Rescale straight into the payload of the UDP blocks.
+                std::size_t pos = 0;
+                udp_output->setStamp(stamp);
+
+                while (pos < iqsamples.size())
+                {
+                    unsigned int nbSamples;
+                    IQSample *payload = udp_output->getWriteSpan(nbSamples);
+                    nbSamples = std::min((std::size_t) nbSamples, iqsamples.size() - pos);
+                    downsampler.rescale(sampleSize, &iqsamples[pos], payload, nbSamples);
+                    udp_output->commitWriteSpan(nbSamples);
+                    pos += nbSamples;
+                }
+
+                source_buffer.recycle(move(iqsamples));
+            }
+        }
+        else
+        {
+            unsigned int sampleSize = source->get_sample_bits() + stamp.m_normShift;
+
+            if (outsamples.empty()) {
+                outsamples = output_buffer.get_block(iqsamples.size() >> downsampler.getLog2Decimation());
+            }
+
+            downsampler.setSampleRate(source->get_sample_rate());
+            downsampler.process(sampleSize, iqsamples, outsamples);
+            source_buffer.recycle(move(iqsamples));
+            decimated_samples += outsamples.size();
+
+            if (channelize)
+            {
+                // Direct write to the output of each channel. The first block only fills the
+                // filter history and is thrown away like below.
+                write_channels(channel, outputs, outsamples, channel_samples, sampleSize, stamp, block > 0);
+                continue;
+            }
+
+            udp_output->setSampleBits(sampleSize);
+            udp_output->setSampleBytes((sampleSize -1)/8 + 1);
+            udp_output->setSampleRate(downsampler.getOutputSampleRate());
+
+            // Throw away first block. It is noisy because IF filters
+            // are still starting up.
+            if (block > 0)
+            {
+                // Write samples to output.
+                if (outputbuf_samples > 0)
+                {
+                    // Buffered write. The first output sample is the decimation of the first input sample.
+                    output_buffer.push(move(outsamples), stamp);
+                }
+                else
+                {
+                    // Direct write.
+                    udp_output->setStamp(stamp);
+                    udp_output->write(outsamples);
+                }
+            }
+        }
+    }
+
+    // Stop device and flush output.
+    source_buffer.push_end(); // release device thread if waiting for room
+    source->stop();
+
+    if (channel->output_thread.joinable())
+    {
+        output_buffer.push_end();
+        channel->output_thread.join();
+    }
+
+    running_channels--;
+}
 
 int main(int argc, char **argv)
 {
-    int     devidx  = 0;
-    std::string  filename;
-    std::string  alsadev("default");
-    std::string config_str;
-    std::string devtype_str;
-    std::vector<std::string> devnames;
-    std::string dataaddress("127.0.0.1");
-    unsigned int dataport = 9090;
-    unsigned int cfgport = 9091;
+    std::vector<std::unique_ptr<RxChannel>> channels;
+    std::map<std::string, std::vector<std::string>> devnames; // by device type
+    unsigned int ring_slots = 0;
+    unsigned int txframes = UDPSINKFEC_NBTXBLOCKS;
+    int stats_period = 0;
+    std::string thread_error;
+    unsigned int queue_samples = 0;
+    DataBuffer<IQSample>::OverflowPolicy queue_policy = DataBuffer<IQSample>::OverflowDropOldest;
     DeviceSource  *srcsdr = 0;
     unsigned int outputbuf_samples = 48 * UDPSIZE;
 //    uint32_t compressedMinSize = 0;
 //    bool useFec = true;
-    unsigned int nbFECBlocks = 0;
-    unsigned int txDelay = 0;
 
     fprintf(stderr,
             "SDRDaemonRx - Collect samples from SDR device and send it over the network via UDP\n");
@@ -402,24 +810,36 @@ int main(int argc, char **argv)
         { "daddress",   2, NULL, 'I' },
         { "dport",      1, NULL, 'D' },
         { "cport",      1, NULL, 'C' },
+        { "channels",   1, NULL, 'N' },
+        { "ring",       1, NULL, 'r' },
+        { "qsize",      1, NULL, 'q' },
+        { "policy",     1, NULL, 'P' },
+        { "txframes",   1, NULL, 'F' },
+        { "stats",      1, NULL, 'S' },
+        { "thread",     1, NULL, 'A' },
+        { "simd",       1, NULL, 'M' },
         { NULL,         0, NULL, 0 } };
 
     int c, longindex, value;
     while ((c = getopt_long(argc, argv,
-            "t:c:d:b:I:D:C:",
+            "t:c:d:b:I:D:C:N:r:q:P:F:S:A:M:",
             longopts, &longindex)) >= 0)
     {
         switch (c)
         {
             case 't':
-                devtype_str.assign(optarg);
+                // each device type starts a new device unless options were given before the first one
+                if (!channels.empty() && !channels.back()->devtype.empty()) {
+                    channels.push_back(std::unique_ptr<RxChannel>(new RxChannel()));
+                }
+                current_channel(channels)->devtype.assign(optarg);
                 break;
             case 'c':
-                config_str.assign(optarg);
+                current_channel(channels)->config.assign(optarg);
                 break;
             case 'd':
-                if (!parse_int(optarg, devidx))
-                    devidx = -1;
+                if (!parse_int(optarg, current_channel(channels)->devidx))
+                    current_channel(channels)->devidx = -1;
                 break;
             case 'b':
                 if (!parse_int(optarg, value) || (value < 0)) {
@@ -429,20 +849,78 @@ int main(int argc, char **argv)
                 }
                 break;
             case 'I':
-                dataaddress.assign(optarg);
+                current_channel(channels)->dataaddress.assign(optarg);
                 break;
             case 'D':
                 if (!parse_int(optarg, value) || (value < 0)) {
                     badarg("-D");
                 } else {
-                    dataport = value;
+                    current_channel(channels)->dataport = value;
                 }
                 break;
             case 'C':
                 if (!parse_int(optarg, value) || (value < 0)) {
                     badarg("-C");
                 } else {
-                    cfgport = value;
+                    current_channel(channels)->cfgport = value;
+                }
+                break;
+            case 'N':
+                if (!parse_int(optarg, value) || (value < 0) || (value > CHANNELIZER_MAX_CHANNELS)) {
+                    badarg("-N");
+                } else {
+                    current_channel(channels)->nbchannels = value;
+                }
+                break;
+            case 'r':
+                if (!parse_int(optarg, value) || (value < 0)) {
+                    badarg("-r");
+                } else {
+                    ring_slots = value;
+                }
+                break;
+            case 'q':
+                if (!parse_int(optarg, value, true) || (value < 0)) {
+                    badarg("-q");
+                } else {
+                    queue_samples = value;
+                }
+                break;
+            case 'P':
+                if (strcasecmp(optarg, "block") == 0) {
+                    queue_policy = DataBuffer<IQSample>::OverflowBlock;
+                } else if (strcasecmp(optarg, "newest") == 0) {
+                    queue_policy = DataBuffer<IQSample>::OverflowDropNewest;
+                } else if (strcasecmp(optarg, "oldest") == 0) {
+                    queue_policy = DataBuffer<IQSample>::OverflowDropOldest;
+                } else {
+                    badarg("-P");
+                }
+                break;
+            case 'F':
+                if (!parse_int(optarg, value) || (value < 2)) {
+                    badarg("-F");
+                } else {
+                    txframes = value;
+                }
+                break;
+            case 'S':
+                if (!parse_int(optarg, value) || (value < 0)) {
+                    badarg("-S");
+                } else {
+                    stats_period = value;
+                }
+                break;
+            case 'A':
+                if (!ThreadConfig::parse(optarg, thread_error)) {
+                    fprintf(stderr, "ERROR: -A %s: %s\n", optarg, thread_error.c_str());
+                    exit(1);
+                }
+                break;
+            case 'M':
+                if (!CpuFeatures::setLevel(optarg)) {
+                    fprintf(stderr, "ERROR: -M %s: unknown level or not supported by this CPU\n", optarg);
+                    exit(1);
                 }
                 break;
             default:
@@ -459,6 +937,63 @@ int main(int argc, char **argv)
         exit(1);
     }
 
+    current_channel(channels);
+
+    // Default destination is the one of the previous device and ports follow the ones of device #0
+    for (unsigned int i = 0; i < channels.size(); i++)
+    {
+        RxChannel *channel = channels[i].get();
+
+        if (channel->dataaddress.empty()) {
+            channel->dataaddress = (i == 0 ? "127.0.0.1" : channels[i-1]->dataaddress);
+        }
+
+        if (channel->dataport < 0) {
+            channel->dataport = 9090 + 2*i;
+        }
+
+        if (channel->cfgport < 0) {
+            channel->cfgport = 9091 + 2*i;
+        }
+
+        if (channels.size() > 1)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "#%u: ", i);
+            channel->name = name;
+        }
+
+        // the channels of a device are sent to consecutive data ports
+        int nbdataports = std::max(channel->nbchannels, 1U);
+
+        if ((channel->nbchannels > 0) && !channel->channelizer.setNbChannels(channel->nbchannels))
+        {
+            fprintf(stderr, "ERROR: device #%u: number of channels must be a power of two from 2 to %d\n", i, CHANNELIZER_MAX_CHANNELS);
+            exit(1);
+        }
+
+        if (channel->dataport + nbdataports - 1 > 65535)
+        {
+            fprintf(stderr, "ERROR: device #%u: data ports %d to %d: the last one is above 65535\n",
+                    i, channel->dataport, channel->dataport + nbdataports - 1);
+            exit(1);
+        }
+
+        for (unsigned int j = 0; j < i; j++)
+        {
+            int jdataports = std::max(channels[j]->nbchannels, 1U);
+
+            if ((channels[j]->cfgport == channel->cfgport)
+             || ((channels[j]->dataport < channel->dataport + nbdataports)
+              && (channel->dataport < channels[j]->dataport + jdataports)
+              && (channels[j]->dataaddress == channel->dataaddress)))
+            {
+                fprintf(stderr, "ERROR: devices #%u and #%u use the same port\n", j, i);
+                exit(1);
+            }
+        }
+    }
+
     // Catch Ctrl-C and SIGTERM
     struct sigaction sigact;
     sigact.sa_handler = handle_sigterm;
@@ -475,205 +1010,188 @@ int main(int argc, char **argv)
         fprintf(stderr, "WARNING: can not install SIGTERM handler (%s)\n", strerror(errno));
     }
 
-    // Prepare output writer.
-    UDPSink *udp_output_instance;
-    udp_output_instance = new UDPSinkFEC(dataaddress, dataport);
-
-//    if (useFec) {
-//        udp_output_instance = new UDPSinkFEC(dataaddress, dataport);
-//    } else if (compressedMinSize) {
-//        udp_output_instance = new UDPSinkLZ4(dataaddress, dataport, UDPSIZE, compressedMinSize);
-//    } else {
-//        udp_output_instance = new UDPSinkUncompressed(dataaddress, dataport, UDPSIZE);
-//    }
+    fprintf(stderr, "SIMD kernels:      convert %s, halfband filter %s (16 bit %s)\n",
+            SampleConverter::kernelName(),
+            IntHalfbandFilterBlock<DECIMATORS_HB_FILTER_ORDER>::kernelName(),
+            IntHalfbandFilterBlock<DECIMATORS_HB_FILTER_ORDER>::kernel16Name());
 
-    std::unique_ptr<UDPSink> udp_output(udp_output_instance);
-
-    if (!(*udp_output))
+    // List the devices of each type once before any is opened: the libraries open the
+    // devices while listing them and those already opened would be missing from a later list.
+    for (unsigned int i = 0; i < channels.size(); i++)
     {
-        fprintf(stderr, "ERROR: UDP Output: %s\n", udp_output->error().c_str());
-        exit(1);
-    }
+        RxChannel *channel = channels[i].get();
+        std::transform(channel->devtype.begin(), channel->devtype.end(), channel->devtype.begin(), ::tolower);
 
-    if (!get_device(devnames, devtype_str, &srcsdr, devidx))
-    {
-        exit(1);
-    }
+        if ((devnames.find(channel->devtype) == devnames.end())
+         && !list_devices(devnames[channel->devtype], channel->devtype))
+        {
+            exit(1);
+        }
 
-    if (!(*srcsdr))
-    {
-        fprintf(stderr, "ERROR source: %s\n", srcsdr->error().c_str());
-        delete srcsdr;
-        exit(1);
+        for (unsigned int j = 0; j < i; j++)
+        {
+            if ((channels[j]->devtype == channel->devtype) && (channels[j]->devidx == channel->devidx)
+             && (channel->devtype != "test") && (channel->devtype != "replay"))
+            {
+                fprintf(stderr, "ERROR: devices #%u and #%u are the same %s device %d\n",
+                        j, i, channel->devtype.c_str(), channel->devidx);
+                exit(1);
+            }
+        }
     }
 
-    //fprintf(stderr, (std::is_trivially_copyable<IQSample>::value ? "IQSample is trivially copiable\n" : "IQSample is NOT trivially copiable\n"));
-
-    // Configure device and start streaming.
+    // Decimated sample blocks are recycled through this pool between the processing and output threads.
+    BufferPool<IQSample> buffer_pool(32 * channels.size());
 
-    srcsdr->setConfigurationPort(cfgport);
+    // Threads sharing the decimation of blocks of all devices.
+    WorkerPool worker_pool;
 
-    // Prepare downsampler.
-    Downsampler dn;
-    srcsdr->associateDownsampler(&dn);
-
-    if (!srcsdr->configure(config_str))
+    // Open and configure all devices before streaming from any of them.
+    for (unsigned int i = 0; i < channels.size(); i++)
     {
-        fprintf(stderr, "ERROR: source configuration: %s\n", srcsdr->error().c_str());
-        delete srcsdr;
-        exit(1);
-    }
+        RxChannel *channel = channels[i].get();
 
-    /*
-    if (!dn.configure(m))
-    {
-        fprintf(stderr, "ERROR: downsampler configuration: %s\n", dn.error().c_str());
-        delete srcsdr;
-        exit(1);
-    }*/
+        // Prepare output writer.
+        channel->udp_output.reset(new UDPSinkFEC(channel->dataaddress, channel->dataport, txframes));
 
-    double freq = srcsdr->get_received_frequency();
-    fprintf(stderr, "tuned for:         %.6f MHz\n", freq * 1.0e-6);
+//        if (useFec) {
+//            udp_output_instance = new UDPSinkFEC(dataaddress, dataport);
+//        } else if (compressedMinSize) {
+//            udp_output_instance = new UDPSinkLZ4(dataaddress, dataport, UDPSIZE, compressedMinSize);
+//        } else {
+//            udp_output_instance = new UDPSinkUncompressed(dataaddress, dataport, UDPSIZE);
+//        }
 
-    double tuner_freq = srcsdr->get_frequency();
-    fprintf(stderr, "device tuned for:  %.6f MHz\n", tuner_freq * 1.0e-6);
+        if (!(*channel->udp_output))
+        {
+            fprintf(stderr, "ERROR: %sUDP Output: %s\n", channel->name.c_str(), channel->udp_output->error().c_str());
+            exit(1);
+        }
 
-    double ifrate = srcsdr->get_sample_rate();
-    fprintf(stderr, "IF sample rate:    %.0f Hz\n", ifrate);
+        // Outputs of the next channels when the band is split.
+        for (unsigned int k = 1; k < channel->nbchannels; k++)
+        {
+            channel->channel_outputs.push_back(std::unique_ptr<UDPSinkFEC>(new UDPSinkFEC(channel->dataaddress, channel->dataport + k, txframes)));
 
-    srcsdr->print_specific_parms();
+            if (!(*channel->channel_outputs.back()))
+            {
+                fprintf(stderr, "ERROR: %sUDP Output of channel %u: %s\n", channel->name.c_str(), k, channel->channel_outputs.back()->error().c_str());
+                exit(1);
+            }
+        }
 
-    // Create source data queue.
-    DataBuffer<IQSample> source_buffer;
+        srcsdr = 0;
 
-    // ownership will be transferred to thread therefore the unique_ptr with move is convenient
-    // if the pointer is to be shared with the main thread use shared_ptr (and no move) instead
-    std::unique_ptr<DeviceSource> up_srcsdr(srcsdr);
+        if (!get_device(devnames[channel->devtype], channel->devtype, &srcsdr, channel->devidx))
+        {
+            exit(1);
+        }
 
-    // Start reading from device in separate thread.
-    //std::thread source_thread(read_source_data, std::move(up_srcsdr), &source_buffer);
-    up_srcsdr->start(&source_buffer, &stop_flag);
+        // ownership will be kept by the channel until the end of the process
+        channel->source.reset(srcsdr);
 
-    if (!up_srcsdr)
-    {
-        fprintf(stderr, "ERROR: source: %s\n", up_srcsdr->error().c_str());
-        exit(1);
-    }
+        if (!(*srcsdr))
+        {
+            fprintf(stderr, "ERROR source: %s%s\n", channel->name.c_str(), srcsdr->error().c_str());
+            exit(1);
+        }
 
-    // If buffering enabled, start background output thread.
-    DataBuffer<IQSample> output_buffer;
-    std::thread output_thread;
+        //fprintf(stderr, (std::is_trivially_copyable<IQSample>::value ? "IQSample is trivially copiable\n" : "IQSample is NOT trivially copiable\n"));
 
-    if (outputbuf_samples > 0)
-    {
-        output_thread = std::thread(write_output_data,
-                               udp_output.get(),
-                               &output_buffer,
-                               outputbuf_samples);
-    }
+        // Configure device.
 
-    IQSampleVector outsamples;
-    bool inbuf_length_warning = false;
+        srcsdr->setConfigurationPort(channel->cfgport);
 
-    // Main loop.
-    for (unsigned int block = 0; !stop_flag.load(); block++)
-    {
+        // Prepare downsampler.
+        channel->downsampler.setWorkerPool(&worker_pool);
+        channel->channelizer.setWorkerPool(&worker_pool);
+        srcsdr->associateDownsampler(&channel->downsampler);
 
-        // Check for overflow of source buffer.
-        if (!inbuf_length_warning && source_buffer.queued_samples() > 10 * ifrate)
+        if (!srcsdr->configure(channel->config))
         {
-            fprintf(stderr, "\nWARNING: Input buffer is growing (system too slow)\n");
-            inbuf_length_warning = true;
+            fprintf(stderr, "ERROR: %ssource configuration: %s\n", channel->name.c_str(), srcsdr->error().c_str());
+            exit(1);
         }
 
-        // Pull next block from source buffer.
-        IQSampleVector iqsamples = source_buffer.pull();
+        fprintf(stderr, "%ssending to:        %s:%d control port %d\n", channel->name.c_str(),
+                channel->dataaddress.c_str(), channel->dataport, channel->cfgport);
 
-        if (iqsamples.empty())
+        if (channel->nbchannels > 0)
         {
-            break;
+            fprintf(stderr, "%schannels:          %u on ports %d to %d, prototype filter of %u taps\n", channel->name.c_str(),
+                    channel->nbchannels, channel->dataport, channel->dataport + channel->nbchannels - 1,
+                    channel->nbchannels * CHANNELIZER_BRANCH_TAPS);
         }
 
-        udp_output->setCenterFrequency(srcsdr->get_received_frequency());
+        double freq = srcsdr->get_received_frequency();
+        fprintf(stderr, "%stuned for:         %.6f MHz\n", channel->name.c_str(), freq * 1.0e-6);
 
-        unsigned int confNbFECBlocks = srcsdr->get_nb_fec_blocks();
+        double tuner_freq = srcsdr->get_frequency();
+        fprintf(stderr, "%sdevice tuned for:  %.6f MHz\n", channel->name.c_str(), tuner_freq * 1.0e-6);
 
-        if (confNbFECBlocks != nbFECBlocks)
-        {
-            nbFECBlocks = confNbFECBlocks;
-            udp_output->setNbBlocksFEC(nbFECBlocks);
-        }
+        double ifrate = srcsdr->get_sample_rate();
+        fprintf(stderr, "%sIF sample rate:    %.0f Hz\n", channel->name.c_str(), ifrate);
 
-        unsigned int confTxDelay = srcsdr->get_tx_delay();
+        srcsdr->print_specific_parms();
+    }
 
-        if (confTxDelay != txDelay)
-        {
-            txDelay = confTxDelay;
-            udp_output->setTxDelay(txDelay);
-        }
+    // Start streaming.
+    for (unsigned int i = 0; i < channels.size(); i++)
+    {
+        RxChannel *channel = channels[i].get();
+        DeviceSource *source = channel->source.get();
 
-        // Possible downsampling and write to UDP
+        // Create source data queue.
+        channel->source_buffer.reset(new DataBuffer<IQSample>(ring_slots));
+        channel->source_buffer->set_pool(&channel->source_pool);
+        channel->source_buffer->set_capacity(queue_samples, queue_policy);
 
-        if (dn.getLog2Decimation() == 0)
-        {
-            unsigned int sampleSize = srcsdr->get_sample_bits();
-        	dn.rescale(sampleSize, iqsamples);
+        // Without channels have the device conversion normalize samples to 16 bits when not decimating
+        source->set_normalize(channel->nbchannels == 0);
 
-            udp_output->setSampleBits(srcsdr->get_sample_bits());
-            udp_output->setSampleBytes((srcsdr->get_sample_bits()-1)/8 + 1);
-            udp_output->setSampleRate(srcsdr->get_sample_rate());
+        // Start reading from device in separate thread.
+        source->start(channel->source_buffer.get(), &stop_flag);
 
-            if (outputbuf_samples > 0)
-            {
-                // Buffered write.
-                output_buffer.push(move(iqsamples));
-            }
-            else
-            {
-                // Direct write.
-                udp_output->write(iqsamples);
-            }
-        }
-        else
+        if (!(*source))
         {
-            unsigned int sampleSize = srcsdr->get_sample_bits();
-            dn.process(sampleSize, iqsamples, outsamples);
+            fprintf(stderr, "ERROR: %ssource: %s\n", channel->name.c_str(), source->error().c_str());
+            exit(1);
+        }
 
-            udp_output->setSampleBits(sampleSize);
-            udp_output->setSampleBytes((sampleSize -1)/8 + 1);
-            udp_output->setSampleRate(srcsdr->get_sample_rate() / (1<<dn.getLog2Decimation()));
+        // If buffering enabled, start background output thread.
+        // The output buffer is bounded to one second of device samples. When full
+        // the decimation stage waits and overload shows up in the source buffer.
+        channel->output_buffer.set_pool(&buffer_pool);
+        channel->output_buffer.set_capacity(std::max((unsigned int) source->get_sample_rate(), 4 * outputbuf_samples),
+                DataBuffer<IQSample>::OverflowBlock);
 
-            // Throw away first block. It is noisy because IF filters
-            // are still starting up.
-            if (block > 0)
-            {
-                // Write samples to output.
-                if (outputbuf_samples > 0)
-                {
-                    // Buffered write.
-                    output_buffer.push(move(outsamples));
-                }
-                else
-                {
-                    // Direct write.
-                    udp_output->write(outsamples);
-                }
-            }
+        // The channels are written directly by the processing thread.
+        if ((outputbuf_samples > 0) && (channel->nbchannels == 0))
+        {
+            channel->output_thread = std::thread(write_output_data,
+                                   channel->udp_output.get(),
+                                   &channel->output_buffer,
+                                   outputbuf_samples);
         }
-    }
 
-    fprintf(stderr, "\n");
+        running_channels++;
+        channel->thread = std::thread(process_channel, channel, outputbuf_samples, stats_period);
+    }
 
-    // Join background threads.
-    //source_thread.join();
-    up_srcsdr->stop();
+    // Wait for a signal or for all devices to reach the end of their stream.
+    while (!stop_flag.load() && (running_channels.load() > 0)) {
+        usleep(100000);
+    }
 
-    if (outputbuf_samples > 0)
+    // Release processing threads waiting for samples of stopped devices then wait for them.
+    for (unsigned int i = 0; i < channels.size(); i++)
     {
-        output_buffer.push_end();
-        output_thread.join();
+        channels[i]->source_buffer->push_end();
+        channels[i]->thread.join();
     }
 
+    fprintf(stderr, "\n");
+
     // No cleanup needed; everything handled by destructors
 
     return 0;
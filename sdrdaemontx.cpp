@@ -41,7 +41,11 @@
 
 #include "util.h"
 #include "DataBuffer.h"
+#include "BufferPool.h"
+#include "ThreadConfig.h"
 #include "Upsampler.h"
+#include "IntHalfbandFilterBlock.h"
+#include "CpuFeatures.h"
 #include "UDPSourceFEC.h"
 
 #ifdef HAS_HACKRF
@@ -77,10 +81,15 @@ void read_input_data(UDPSource *input,
         std::size_t buf_maxfill)
 {
     IQSampleVector samples;
+    ThreadConfig::apply("input");
 
     while (!stop_flag.load())
     {
         // Get samples from UDP
+        if (samples.empty()) {
+            samples = buf->get_block(0);
+        }
+
         input->read(samples);
 
         if (!(*input))
@@ -135,6 +144,13 @@ void usage()
             "  -D port        Data port. Samples are sent on this UDP port (default 9090)\n"
             "  -C port        Configuration port (default 9091). The configuration string as described below\n"
             "                 is sent on this port via nanomsg in TCP to control the device\n"
+            "  -r slots       Use a lock-free ring of this number of blocks between the device and the\n"
+            "                 processing thread instead of the default unbounded queue (default 0: queue)\n"
+            "  -A spec        Thread settings role:cpus[:policy[:priority]]. May be repeated. Roles are:\n"
+            "                 main, device, control, input. cpus is a list like 0,2-3 (may be empty),\n"
+            "                 policy is other, fifo or rr. Example: -A device:1:fifo:50\n"
+            "  -M level       Restrict SIMD kernels to this instruction set level to compare performance:\n"
+            "                 generic, sse2, sse4.1, avx2, avx512 on x86, generic, neon on ARM (default auto: best)\n"
             "\n"
             "Configuration options for the interpolator:\n"
             "  interp=<int>   log2 of interpolation factor (default 0: no interpolation)\n"
@@ -265,6 +281,8 @@ int main(int argc, char **argv)
     std::string dataaddress("127.0.0.1");
     unsigned int dataport = 9090;
     unsigned int cfgport = 9091;
+    unsigned int ring_slots = 0;
+    std::string thread_error;
     DeviceSink  *sinksdr = 0;
     bool buffered_reads = false;
 
@@ -278,11 +296,14 @@ int main(int argc, char **argv)
         { "daddress",   2, NULL, 'I' },
         { "dport",      1, NULL, 'D' },
         { "cport",      1, NULL, 'C' },
+        { "ring",       1, NULL, 'r' },
+        { "thread",     1, NULL, 'A' },
+        { "simd",       1, NULL, 'M' },
         { NULL,         0, NULL, 0 } };
 
     int c, longindex, value;
     while ((c = getopt_long(argc, argv,
-            "t:c:d:bI:D:C:",
+            "t:c:d:bI:D:C:r:A:M:",
             longopts, &longindex)) >= 0)
     {
         switch (c)
@@ -317,6 +338,25 @@ int main(int argc, char **argv)
                     cfgport = value;
                 }
                 break;
+            case 'r':
+                if (!parse_int(optarg, value) || (value < 0)) {
+                    badarg("-r");
+                } else {
+                    ring_slots = value;
+                }
+                break;
+            case 'A':
+                if (!ThreadConfig::parse(optarg, thread_error)) {
+                    fprintf(stderr, "ERROR: -A %s: %s\n", optarg, thread_error.c_str());
+                    exit(1);
+                }
+                break;
+            case 'M':
+                if (!CpuFeatures::setLevel(optarg)) {
+                    fprintf(stderr, "ERROR: -M %s: unknown level or not supported by this CPU\n", optarg);
+                    exit(1);
+                }
+                break;
             default:
                 usage();
                 fprintf(stderr, "ERROR: Invalid command line options\n");
@@ -331,6 +371,9 @@ int main(int argc, char **argv)
         exit(1);
     }
 
+    fprintf(stderr, "SIMD kernels:      halfband filter %s\n",
+            IntHalfbandFilterBlock<INTERPOLATORS_HB_FILTER_ORDER_FIRST>::kernelName());
+
     // Catch Ctrl-C and SIGTERM
     struct sigaction sigact;
     sigact.sa_handler = handle_sigterm;
@@ -413,7 +456,11 @@ int main(int argc, char **argv)
     sinksdr->print_specific_parms();
 
     // Create source data queue.
-    DataBuffer<IQSample> sink_buffer;
+    DataBuffer<IQSample> sink_buffer(ring_slots);
+
+    // Sample blocks are recycled through this pool between network and device.
+    BufferPool<IQSample> buffer_pool;
+    sink_buffer.set_pool(&buffer_pool);
 
     // ownership will be transferred to thread therefore the unique_ptr with move is convenient
     // if the pointer is to be shared with the main thread use shared_ptr (and no move) instead
@@ -432,6 +479,7 @@ int main(int argc, char **argv)
     // If buffering enabled, start background input thread.
     DataBuffer<IQSample> input_buffer;
     std::thread input_thread;
+    input_buffer.set_pool(&buffer_pool);
 
     if (buffered_reads)
     {
@@ -445,6 +493,9 @@ int main(int argc, char **argv)
     bool sink_buf_overflow_warning = false;
     bool sink_buf_underflow_warning = false;
 
+    // Applied after all other threads are started so that they do not inherit it
+    ThreadConfig::apply("main");
+
     // Main loop.
     for (unsigned int block = 0; !stop_flag.load(); block++)
     {
@@ -474,10 +525,15 @@ int main(int argc, char **argv)
 
         if (buffered_reads)
         {
+            input_buffer.recycle(move(insamples));
             input_buffer.pull(insamples);
         }
         else
         {
+            if (insamples.empty()) {
+                insamples = sink_buffer.get_block(0);
+            }
+
             udp_input->read(insamples);
         }
 
@@ -490,6 +546,10 @@ int main(int argc, char **argv)
             }
             else
             {
+                if (outsamples.empty()) {
+                    outsamples = sink_buffer.get_block(insamples.size() << up.getLog2Interpolation());
+                }
+
                 up.process(insamples, outsamples);
 //                fprintf(stderr, "upsampling: push %lu samples\n", outsamples.size());
                 sink_buffer.push(move(outsamples));
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "SampleConverter.h"
+#include "CpuFeatures.h"
+
+/**
+ * Compare the 8 bit to 16 bit conversion kernel selected for a SIMD level with
+ * the plain per sample conversion the devices used before followed by the
+ * normalization shift of Decimators::decimate1, for every shift from 0 to 15.
+ * Lengths cover the scalar tails of every kernel.
+ *
+ * Usage: testconverter [level] (default auto). Exits with 77 when the CPU does
+ * not support the level so that the test is reported as skipped.
+ */
+static bool same(const IQSample& a, const IQSample& b)
+{
+    return (a.real() == b.real()) && (a.imag() == b.imag());
+}
+
+static IQSample normalized(int real, int imag, unsigned int shift)
+{
+    return IQSample(real * (1 << shift), imag * (1 << shift)); // like Decimators::decimate1
+}
+
+static int check(const char *format, bool offsetBinary, const std::vector<uint8_t>& bytes, std::size_t nbSamples, unsigned int shift)
+{
+    std::vector<IQSample> out(nbSamples + 1, IQSample(0x5555, 0x5555));
+
+    if (offsetBinary) {
+        SampleConverter::convertU8(bytes.data(), out.data(), nbSamples, shift);
+    } else {
+        SampleConverter::convertS8((const int8_t *) bytes.data(), out.data(), nbSamples, shift);
+    }
+
+    for (std::size_t i = 0; i < nbSamples; i++)
+    {
+        IQSample expected = offsetBinary ?
+            normalized(bytes[2*i] - 128, bytes[2*i+1] - 128, shift) :
+            normalized((int8_t) bytes[2*i], (int8_t) bytes[2*i+1], shift);
+
+        if (!same(out[i], expected))
+        {
+            fprintf(stderr, "%s shift %u %lu samples: sample %lu is (%d,%d) instead of (%d,%d)\n",
+                    format, shift, (unsigned long) nbSamples, (unsigned long) i, out[i].real(), out[i].imag(), expected.real(), expected.imag());
+            return 1;
+        }
+    }
+
+    if (!same(out[nbSamples], IQSample(0x5555, 0x5555)))
+    {
+        fprintf(stderr, "%s shift %u %lu samples: written past the end\n", format, shift, (unsigned long) nbSamples);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *level = (argc > 1 ? argv[1] : "auto");
+
+    if (!CpuFeatures::setLevel(level))
+    {
+        fprintf(stderr, "testconverter: level %s not supported by this CPU: skipped\n", level);
+        return 77;
+    }
+
+    std::vector<uint8_t> bytes(2*1000);
+
+    for (std::size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = i < 256 ? i : rand(); // all values then random ones
+    }
+
+    int failures = 0;
+
+    for (unsigned int shift = 0; shift < 16; shift++)
+    {
+        for (std::size_t nbSamples = 0; nbSamples <= bytes.size()/2; nbSamples += (nbSamples < 40 ? 1 : 97))
+        {
+            failures += check("u8", true, bytes, nbSamples, shift);
+            failures += check("s8", false, bytes, nbSamples, shift);
+        }
+    }
+
+    fprintf(stderr, "testconverter: %s kernel: %s\n", SampleConverter::kernelName(), failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
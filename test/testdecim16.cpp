@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "Decimators.h"
+#include "IntHalfbandFilterBlock.h"
+#include "CpuFeatures.h"
+
+#define TESTDECIM16_SAMPLES 65536
+#define TESTDECIM16_MIN_SNR 90.0 // dB of the 32 bit output over the difference
+
+typedef HBFilterCascade<DECIMATORS_MAX_STAGES, DECIMATORS_HB_FILTER_ORDERS> Cascade;
+
+/**
+ * Compare the decimation of samples of every size that Decimators runs partly on
+ * 16 bits with the same decimation run on 32 bits from the input. The first stages
+ * are run on 16 bits as long as their output fits like Decimators::stages16 does.
+ * The input is a tone near full scale plus noise. The maximum difference and the
+ * signal to difference ratio are printed and the difference must stay below 1 LSB
+ * of the input with a ratio of at least TESTDECIM16_MIN_SNR dB.
+ *
+ * Usage: testdecim16 [level] (default auto). Exits with 77 when the CPU does
+ * not support the level so that the test is reported as skipped.
+ */
+static int check(unsigned int sampleSize, unsigned int log2Decim)
+{
+    unsigned int nb16 = 0;
+
+    while ((nb16 < log2Decim) && (sampleSize + 2*nb16 <= DECIMATORS_S16_MAX_BITS)) { // like Decimators::stages16
+        nb16++;
+    }
+
+    if (nb16 == 0) {
+        return 0;
+    }
+
+    int scale = (1 << (sampleSize - 1)) - 1;
+    std::vector<int16_t> in(2*TESTDECIM16_SAMPLES);
+    std::vector<int16_t> buf16(2*TESTDECIM16_SAMPLES);
+    std::vector<int32_t> ref(2*TESTDECIM16_SAMPLES);
+    std::vector<int32_t> out(2*TESTDECIM16_SAMPLES);
+
+    for (unsigned int k = 0; k < TESTDECIM16_SAMPLES; k++)
+    {
+        double phase = 2.0 * M_PI * k * 0.1 / (1 << log2Decim);
+        in[2*k]   = lrint(0.9 * scale * cos(phase) + 0.1 * scale * (rand() / (double) RAND_MAX - 0.5));
+        in[2*k+1] = lrint(0.9 * scale * sin(phase) + 0.1 * scale * (rand() / (double) RAND_MAX - 0.5));
+        ref[2*k]   = in[2*k];
+        ref[2*k+1] = in[2*k+1];
+    }
+
+    Cascade cascade32, cascade16;
+    cascade32.decimate(log2Decim, ref.data(), TESTDECIM16_SAMPLES);
+    cascade16.decimate(nb16, in.data(), buf16.data(), TESTDECIM16_SAMPLES);
+    std::copy(buf16.begin(), buf16.begin() + 2*(TESTDECIM16_SAMPLES >> nb16), out.begin());
+    cascade16.decimate(log2Decim, out.data(), TESTDECIM16_SAMPLES >> nb16, nb16);
+
+    unsigned int nbOut = TESTDECIM16_SAMPLES >> log2Decim;
+    unsigned int gain = log2Decim; // each stage keeps the bit it gains
+    double signal = 0.0, noise = 0.0;
+    int32_t maxError = 0;
+
+    for (unsigned int k = 0; k < 2*nbOut; k++)
+    {
+        int32_t error = std::abs(out[k] - ref[k]);
+        maxError = std::max(maxError, error);
+        signal += (double) ref[k] * ref[k];
+        noise += (double) error * error;
+    }
+
+    double snr = (noise == 0.0 ? INFINITY : 10.0 * log10(signal / noise));
+    bool failed = (maxError >= (1 << gain)) || (snr < TESTDECIM16_MIN_SNR);
+
+    fprintf(stderr, "%2u bits decimation by %2u (%u stages on 16 bits): max error %d (%.3f LSB) SNR %.1f dB%s\n",
+            sampleSize, 1 << log2Decim, nb16, maxError, maxError / (double) (1 << gain), snr, failed ? " FAILED" : "");
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *level = (argc > 1 ? argv[1] : "auto");
+
+    if (!CpuFeatures::setLevel(level))
+    {
+        fprintf(stderr, "testdecim16: level %s not supported by this CPU: skipped\n", level);
+        return 77;
+    }
+
+    int failures = 0;
+
+    for (unsigned int sampleSize = 8; sampleSize <= DECIMATORS_S16_MAX_BITS; sampleSize++)
+    {
+        for (unsigned int log2Decim = 1; log2Decim <= DECIMATORS_MAX_STAGES; log2Decim++) {
+            failures += check(sampleSize, log2Decim);
+        }
+    }
+
+    fprintf(stderr, "testdecim16: %s kernel: %s\n", IntHalfbandFilterBlock<DECIMATORS_HB_FILTER_ORDER>::kernel16Name(),
+            failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Downsampler.h"
+#include "CpuFeatures.h"
+#include "parsekv.h"
+
+#define TESTDTHREADS_BLOCKS 12
+#define TESTDTHREADS_MAX_BLOCK 20000
+
+/**
+ * Decimate the same blocks of random lengths with one thread and with several
+ * threads sharing each block (dthreads) and compare: the output must be the same.
+ * Block lengths are not multiples of the decimation so the samples dropped at the
+ * end of a block must be the same too. The decimation with a frequency shift is
+ * checked as well.
+ *
+ * Usage: testdthreads [level] (default auto). Exits with 77 when the CPU does
+ * not support the level so that the test is reported as skipped.
+ */
+static int check(unsigned int sampleSize, unsigned int decim, unsigned int fcPos, int fshift, unsigned int nbThreads)
+{
+    Downsampler single, parallel;
+    parsekv::pairs_type config;
+    config["decim"] = std::to_string(decim);
+    config["fcpos"] = std::to_string(fcPos);
+    config["fshift"] = std::to_string(fshift);
+    single.setSampleRate(2000000);
+    parallel.setSampleRate(2000000);
+
+    if (!single.configure(config)) {
+        return 1;
+    }
+
+    config["dthreads"] = std::to_string(nbThreads);
+
+    if (!parallel.configure(config)) {
+        return 1;
+    }
+
+    int range = 1 << sampleSize;
+    std::size_t compared = 0;
+
+    for (unsigned int b = 0; b < TESTDTHREADS_BLOCKS; b++)
+    {
+        IQSampleVector in(rand() % TESTDTHREADS_MAX_BLOCK), out1, outN;
+        unsigned int size1 = sampleSize, sizeN = sampleSize;
+
+        for (std::size_t i = 0; i < in.size(); i++) {
+            in[i] = IQSample((rand() % range) - range/2, (rand() % range) - range/2);
+        }
+
+        single.process(size1, in, out1);
+        parallel.process(sizeN, in, outN);
+
+        if ((out1.size() != outN.size()) || (size1 != sizeN))
+        {
+            fprintf(stderr, "%2u bits decim %u fcpos %u fshift %d dthreads %u: block %u of %lu: %lu samples of %u bits instead of %lu of %u bits\n",
+                    sampleSize, decim, fcPos, fshift, nbThreads, b, (unsigned long) in.size(),
+                    (unsigned long) outN.size(), sizeN, (unsigned long) out1.size(), size1);
+            return 1;
+        }
+
+        for (std::size_t i = 0; i < out1.size(); i++)
+        {
+            if ((out1[i].real() != outN[i].real()) || (out1[i].imag() != outN[i].imag()))
+            {
+                fprintf(stderr, "%2u bits decim %u fcpos %u fshift %d dthreads %u: block %u of %lu: sample %lu differs\n",
+                        sampleSize, decim, fcPos, fshift, nbThreads, b, (unsigned long) in.size(), (unsigned long) i);
+                return 1;
+            }
+        }
+
+        compared += out1.size();
+    }
+
+    return compared == 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned int sampleSizes[] = {8, 12, 16};
+    static const unsigned int threads[] = {2, 3, 4, 7};
+    const char *level = (argc > 1 ? argv[1] : "auto");
+
+    if (!CpuFeatures::setLevel(level))
+    {
+        fprintf(stderr, "testdthreads: level %s not supported by this CPU: skipped\n", level);
+        return 77;
+    }
+
+    int failures = 0;
+
+    for (unsigned int sampleSize : sampleSizes)
+    {
+        for (unsigned int decim = 1; decim <= 6; decim++)
+        {
+            for (unsigned int nbThreads : threads)
+            {
+                for (unsigned int fcPos = 0; fcPos <= 2; fcPos++) {
+                    failures += check(sampleSize, decim, fcPos, 0, nbThreads);
+                }
+
+                failures += check(sampleSize, decim, 2, 123456, nbThreads);
+                failures += check(sampleSize, decim, 0, -45678, nbThreads);
+            }
+        }
+    }
+
+    fprintf(stderr, "testdthreads: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
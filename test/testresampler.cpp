@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////////
+// SDRdaemon - send I/Q samples read from a SDR device over the network via UDP. //
+//                                                                               //
+// Copyright (C) 2017 Edouard Griffiths, F4EXB                                   //
+//                                                                               //
+// This program is free software; you can redistribute it and/or modify          //
+// it under the terms of the GNU General Public License as published by          //
+// the Free Software Foundation as version 3 of the License, or                  //
+//                                                                               //
+// This program is distributed in the hope that it will be useful,               //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of                //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                  //
+// GNU General Public License V3 for more details.                               //
+//                                                                               //
+// You should have received a copy of the GNU General Public License             //
+// along with this program. If not, see <http://www.gnu.org/licenses/>.          //
+///////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "RationalResampler.h"
+
+/**
+ * Resample the same signal in one block and in blocks of a given size, including
+ * empty blocks, and compare: the output must not depend on how the input is split.
+ * Ratios M/L larger than the block size are covered as the next output sample is
+ * then past the end of some blocks. Also check the rates setRates rejects.
+ */
+static int check(uint32_t inputRate, uint32_t outputRate, std::size_t blockSize)
+{
+    RationalResampler whole, split;
+    IQSampleVector in(50000), expected, out, block;
+
+    if (!whole.setRates(inputRate, outputRate) || !split.setRates(inputRate, outputRate))
+    {
+        fprintf(stderr, "%u to %u S/s: rates rejected\n", inputRate, outputRate);
+        return 1;
+    }
+
+    for (std::size_t i = 0; i < in.size(); i++) {
+        in[i] = IQSample((rand() % 4096) - 2048, (rand() % 4096) - 2048);
+    }
+
+    whole.process(in, expected);
+
+    for (std::size_t i = 0; i < in.size(); i += blockSize)
+    {
+        IQSampleVector chunk(in.begin() + i, in.begin() + std::min(i + blockSize, in.size()));
+        split.process(chunk, block);
+        out.insert(out.end(), block.begin(), block.end());
+        split.process(IQSampleVector(), block);
+        out.insert(out.end(), block.begin(), block.end());
+    }
+
+    if (out.size() != expected.size())
+    {
+        fprintf(stderr, "%u to %u S/s in blocks of %lu: %lu samples instead of %lu\n", inputRate, outputRate,
+                (unsigned long) blockSize, (unsigned long) out.size(), (unsigned long) expected.size());
+        return 1;
+    }
+
+    for (std::size_t i = 0; i < out.size(); i++)
+    {
+        if ((out[i].real() != expected[i].real()) || (out[i].imag() != expected[i].imag()))
+        {
+            fprintf(stderr, "%u to %u S/s in blocks of %lu: sample %lu differs\n", inputRate, outputRate,
+                    (unsigned long) blockSize, (unsigned long) i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int checkRejected(uint32_t inputRate, uint32_t outputRate)
+{
+    RationalResampler resampler;
+
+    if (resampler.setRates(inputRate, outputRate))
+    {
+        fprintf(stderr, "%u to %u S/s: rates accepted\n", inputRate, outputRate);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+
+    failures += check(48000, 48000, 32);
+    failures += check(2400000, 48000, 2048);
+    failures += check(31250, 600, 32);
+    failures += check(31250, 600, 1);
+    failures += check(37500, 600, 2048);
+    failures += check(64000, 1000, 7);
+
+    failures += checkRejected(37500, 10);
+    failures += checkRejected(10000000, 1);
+    failures += checkRejected(64001, 1000);
+    failures += checkRejected(48000, 48001);
+    failures += checkRejected(0, 48000);
+
+    fprintf(stderr, "testresampler: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}